@@ -0,0 +1,2 @@
+#define HAVE_SETSOCKOPT 1
+#define HAVE_ZLIB 1
@@ -0,0 +1,209 @@
+/*
+  Copyright (c) 2009 by Jakob Schroeter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#include "atom.h"
+
+#include <vector>
+
+namespace gloox
+{
+
+  static const char* atomNames[] =
+  {
+    // stream & stanzas
+    "stream", "features", "error", "iq", "message", "presence", "xml", "xml:lang",
+    "starttls", "proceed", "failure", "success", "challenge", "response", "auth",
+    "mechanisms", "mechanism", "compression", "compress", "compressed", "method",
+    "bind", "session", "resource", "jid", "handshake", "body", "subject", "thread",
+    "show", "status", "priority", "text",
+    // common elements
+    "query", "x", "item", "items", "feature", "identity", "field", "value", "option",
+    "reported", "instructions", "title", "delay", "c", "nick", "actor", "reason",
+    "continue", "invite", "decline", "password", "history", "destroy", "pubsub", "event",
+    "publish", "retract", "subscribe", "unsubscribe", "subscription", "subscriptions",
+    "affiliation", "affiliations", "configure", "options", "create", "purge", "delete",
+    "command", "note", "actions", "si", "file", "range", "desc", "open", "close", "data",
+    "streamhost", "streamhost-used", "activate", "ping", "request", "received",
+    "composing", "paused", "active", "inactive", "gone", "attention", "html",
+    // common attributes
+    "xmlns", "type", "id", "to", "from", "node", "name", "var", "label", "category",
+    "ver", "hash", "ext", "code", "by", "stamp", "role", "sid", "seq", "block-size",
+    "action", "sessionid", "status", "host", "port", "mode", "version", "ask",
+    // well-known values
+    "get", "set", "result", "chat", "groupchat", "headline", "normal", "available",
+    "unavailable", "subscribed", "unsubscribed", "probe", "away", "xa", "dnd", "none",
+    "both", "remove", "cancel", "modify", "wait", "true", "false"
+  };
+
+  static inline unsigned atomHash( const char* str, std::string::size_type len )
+  {
+    unsigned h = 2166136261u;
+    for( std::string::size_type i = 0; i < len; ++i )
+    {
+      h ^= static_cast<unsigned char>( str[i] );
+      h *= 16777619u;
+    }
+    return h;
+  }
+
+  /*
+   * An open-addressing hash table of well-known strings. It is built once, on first use,
+   * and never modified afterwards.
+   */
+  class AtomTable
+  {
+    public:
+      AtomTable()
+      {
+        const std::string* namespaces[] =
+        {
+          &XMLNS_CLIENT, &XMLNS_COMPONENT_ACCEPT, &XMLNS_COMPONENT_CONNECT, &XMLNS_DISCO_INFO,
+          &XMLNS_DISCO_ITEMS, &XMLNS_DISCO_PUBLISH, &XMLNS_ADHOC_COMMANDS, &XMLNS_COMPRESSION,
+          &XMLNS_OFFLINE, &XMLNS_CHAT_STATES, &XMLNS_AMP, &XMLNS_IBB, &XMLNS_FEATURE_NEG,
+          &XMLNS_CHATNEG, &XMLNS_XHTML_IM, &XMLNS_DELAY, &XMLNS_ROSTER, &XMLNS_VERSION,
+          &XMLNS_REGISTER, &XMLNS_PRIVACY, &XMLNS_AUTH, &XMLNS_PRIVATE_XML, &XMLNS_LAST,
+          &XMLNS_SEARCH, &XMLNS_IQ_OOB, &XMLNS_X_DATA, &XMLNS_X_EVENT, &XMLNS_X_OOB,
+          &XMLNS_X_DELAY, &XMLNS_X_GPGSIGNED, &XMLNS_X_GPGENCRYPTED, &XMLNS_VCARD_TEMP,
+          &XMLNS_X_VCARD_UPDATE, &XMLNS_BOOKMARKS, &XMLNS_ANNOTATIONS, &XMLNS_ROSTER_DELIMITER,
+          &XMLNS_XMPP_PING, &XMLNS_SI, &XMLNS_SI_FT, &XMLNS_BYTESTREAMS, &XMLNS_MUC,
+          &XMLNS_MUC_USER, &XMLNS_MUC_ADMIN, &XMLNS_MUC_UNIQUE, &XMLNS_MUC_OWNER,
+          &XMLNS_MUC_ROOMINFO, &XMLNS_MUC_ROOMS, &XMLNS_MUC_REQUEST, &XMLNS_PUBSUB,
+          &XMLNS_PUBSUB_ERRORS, &XMLNS_PUBSUB_EVENT, &XMLNS_PUBSUB_OWNER, &XMLNS_CAPS,
+          &XMLNS_FT_FASTMODE, &XMLNS_STREAM, &XMLNS_XMPP_STREAM, &XMLNS_XMPP_STANZAS,
+          &XMLNS_STREAM_TLS, &XMLNS_STREAM_SASL, &XMLNS_STREAM_BIND, &XMLNS_STREAM_SESSION,
+          &XMLNS_STREAM_IQAUTH, &XMLNS_STREAM_IQREGISTER, &XMLNS_STREAM_COMPRESS,
+          &XMLNS_HTTPBIND, &XMLNS_XMPP_BOSH, &XMLNS_RECEIPTS, &XMLNS_NICKNAME, &XMLNS_JINGLE,
+          &XMLNS_JINGLE_AUDIO_RTP, &XMLNS_JINGLE_ICE_UDP, &XMLNS_JINGLE_RAW_UDP,
+          &XMLNS_JINGLE_VIDEO_RTP, &XMLNS_SHIM, &XMLNS_ATTENTION
+        };
+        const unsigned numNames = sizeof( atomNames ) / sizeof( char* );
+        const unsigned numNamespaces = sizeof( namespaces ) / sizeof( std::string* );
+
+        m_atoms.reserve( numNames + numNamespaces );
+        for( unsigned i = 0; i < numNames; ++i )
+          add( atomNames[i] );
+        for( unsigned i = 0; i < numNamespaces; ++i )
+          add( *namespaces[i] );
+
+        unsigned size = 1;
+        while( size < 2 * m_atoms.size() )
+          size <<= 1;
+        m_mask = size - 1;
+        m_slots.resize( size, -1 );
+        for( unsigned i = 0; i < m_atoms.size(); ++i )
+        {
+          unsigned s = atomHash( m_atoms[i].data(), m_atoms[i].length() ) & m_mask;
+          while( m_slots[s] != -1 )
+            s = ( s + 1 ) & m_mask;
+          m_slots[s] = static_cast<int>( i );
+        }
+      }
+
+      const std::string* find( const char* str, std::string::size_type length ) const
+      {
+        unsigned s = atomHash( str, length ) & m_mask;
+        while( m_slots[s] != -1 )
+        {
+          const std::string& a = m_atoms[m_slots[s]];
+          if( a.length() == length && a.compare( 0, length, str, length ) == 0 )
+            return &a;
+          s = ( s + 1 ) & m_mask;
+        }
+        return 0;
+      }
+
+    private:
+      void add( const std::string& str )
+      {
+        for( unsigned i = 0; i < m_atoms.size(); ++i )
+          if( m_atoms[i] == str )
+            return;
+        m_atoms.push_back( str );
+      }
+
+      std::vector<std::string> m_atoms;
+      std::vector<int> m_slots;
+      unsigned m_mask;
+  };
+
+  static const AtomTable& atomTable()
+  {
+    static const AtomTable table;
+    return table;
+  }
+
+  const std::string* Atom::find( const std::string& str )
+  {
+    return find( str.data(), str.length() );
+  }
+
+  const std::string* Atom::find( const char* str, std::string::size_type length )
+  {
+    if( !length )
+      return &EmptyString;
+
+    return atomTable().find( str, length );
+  }
+
+  Atom::Atom( const std::string& str )
+    : m_str( find( str ) ), m_shared( true )
+  {
+    if( !m_str )
+    {
+      m_str = new std::string( str );
+      m_shared = false;
+    }
+  }
+
+  Atom::Atom( const Atom& right )
+    : m_str( right.m_shared ? right.m_str : new std::string( *right.m_str ) ),
+      m_shared( right.m_shared )
+  {
+  }
+
+  Atom& Atom::operator=( const Atom& right )
+  {
+    if( this == &right )
+      return *this;
+
+    if( !m_shared )
+      delete m_str;
+
+    m_shared = right.m_shared;
+    m_str = m_shared ? right.m_str : new std::string( *right.m_str );
+    return *this;
+  }
+
+  Atom& Atom::operator=( const std::string& str )
+  {
+    const std::string* a = find( str );
+    if( a )
+    {
+      if( !m_shared )
+        delete m_str;
+      m_str = a;
+      m_shared = true;
+    }
+    else if( !m_shared )
+    {
+      *const_cast<std::string*>( m_str ) = str;
+    }
+    else
+    {
+      m_str = new std::string( str );
+      m_shared = false;
+    }
+    return *this;
+  }
+
+}
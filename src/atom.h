@@ -0,0 +1,170 @@
+/*
+  Copyright (c) 2009 by Jakob Schroeter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef ATOM_H__
+#define ATOM_H__
+
+#include "gloox.h"
+
+#include <string>
+
+namespace gloox
+{
+
+  /**
+   * @brief A string handle used for element names, attribute names, namespaces and prefixes.
+   *
+   * gloox keeps a built-in, read-only table of well-known names and namespaces (stanza and
+   * stream element names, common attribute names, all the XMLNS_* namespaces). An Atom whose
+   * value is found in that table points to the shared table entry instead of holding its own
+   * copy. Any other value is stored in a private, heap-allocated string.
+   *
+   * Two shared Atoms are equal exactly if they point to the same table entry, so comparing
+   * them is a pointer comparison.
+   *
+   * The table is never modified after it has been built, so Atoms can be used from any
+   * thread. It is not extended with names seen on the wire, so peers cannot make it grow.
+   *
+   * @author Jakob Schroeter <js@camaya.net>
+   * @since 1.0
+   */
+  class GLOOX_API Atom
+  {
+    public:
+      /**
+       * Creates an empty Atom.
+       */
+      Atom() : m_str( &EmptyString ), m_shared( true ) {}
+
+      /**
+       * Creates an Atom with the given value.
+       * @param str The Atom's value.
+       */
+      explicit Atom( const std::string& str );
+
+      /**
+       * Copy constructor.
+       * @param right The Atom to copy.
+       */
+      Atom( const Atom& right );
+
+      /**
+       * Destructor.
+       */
+      ~Atom() { if( !m_shared ) delete m_str; }
+
+      /**
+       * Assignment operator.
+       * @param right The Atom to copy.
+       * @return A reference to this Atom.
+       */
+      Atom& operator=( const Atom& right );
+
+      /**
+       * Assigns a new value.
+       * @param str The new value.
+       * @return A reference to this Atom.
+       */
+      Atom& operator=( const std::string& str );
+
+      /**
+       * Returns the Atom's value.
+       * @return The Atom's value.
+       */
+      const std::string& str() const { return *m_str; }
+
+      /**
+       * Returns whether the value is empty.
+       * @return @b True if the value is empty, @b false otherwise.
+       */
+      bool empty() const { return m_str->empty(); }
+
+      /**
+       * Returns whether the value is a shared table entry.
+       * @return @b True if the Atom points into the table of well-known strings, @b false otherwise.
+       */
+      bool shared() const { return m_shared; }
+
+      /**
+       * Checks whether this Atom's value equals the given shared table entry (as returned
+       * by find()), or, if @c atom is 0, the given string.
+       * @param atom The result of find( @c str ).
+       * @param str The string to compare against.
+       * @return @b True if the values are equal, @b false otherwise.
+       */
+      bool equals( const std::string* atom, const std::string& str ) const
+        { return atom ? m_str == atom : ( !m_shared && *m_str == str ); }
+
+      /**
+       * Same as equals( const std::string*, const std::string& ), but compares against a
+       * character array if @c atom is 0.
+       * @param atom The result of find( @c str, @c length ).
+       * @param str The characters to compare against. Need not be null-terminated.
+       * @param length The number of characters in @c str.
+       * @return @b True if the values are equal, @b false otherwise.
+       * @since 1.0
+       */
+      bool equals( const std::string* atom, const char* str, std::string::size_type length ) const
+        { return atom ? m_str == atom
+                      : ( !m_shared && m_str->length() == length
+                          && m_str->compare( 0, length, str, length ) == 0 ); }
+
+      /**
+       * Checks two Atoms for equality.
+       * @param right The Atom to compare against.
+       */
+      bool operator==( const Atom& right ) const
+        { return m_str == right.m_str || ( !( m_shared && right.m_shared ) && *m_str == *right.m_str ); }
+
+      /**
+       * Checks two Atoms for inequality.
+       * @param right The Atom to compare against.
+       */
+      bool operator!=( const Atom& right ) const { return !( *this == right ); }
+
+      /**
+       * Checks the Atom's value for equality with a string.
+       * @param right The string to compare against.
+       */
+      bool operator==( const std::string& right ) const { return *m_str == right; }
+
+      /**
+       * Checks the Atom's value for inequality with a string.
+       * @param right The string to compare against.
+       */
+      bool operator!=( const std::string& right ) const { return *m_str != right; }
+
+      /**
+       * Looks up the given string in the table of well-known strings.
+       * @param str The string to look up.
+       * @return The shared table entry, or 0 if @c str is not a well-known string.
+       */
+      static const std::string* find( const std::string& str );
+
+      /**
+       * Looks up the given character array in the table of well-known strings.
+       * @param str The characters to look up. Need not be null-terminated.
+       * @param length The number of characters in @c str.
+       * @return The shared table entry, or 0 if @c str is not a well-known string.
+       */
+      static const std::string* find( const char* str, std::string::size_type length );
+
+    private:
+      const std::string* m_str;
+      bool m_shared;
+
+  };
+
+}
+
+#endif // ATOM_H__
@@ -17,6 +17,7 @@
 #include "disco.h"
 #include "sha.h"
 #include "tag.h"
+#include "util.h"
 
 namespace gloox
 {
@@ -109,6 +110,19 @@ namespace gloox
     return t;
   }
 
+  void Capabilities::appendXml( std::string& out ) const
+  {
+    if( !m_valid || m_node.empty() )
+      return;
+
+    out += "<c";
+    util::appendAttribute( out, "xmlns", XMLNS_CAPS );
+    util::appendAttribute( out, "hash", "sha-1" );
+    util::appendAttribute( out, "node", m_node );
+    util::appendAttribute( out, "ver", ver() );
+    out += "/>";
+  }
+
   StringList Capabilities::handleDiscoNodeFeatures( const JID&, const std::string& )
   {
     return m_disco->features();
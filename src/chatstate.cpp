@@ -57,4 +57,15 @@ namespace gloox
     return new Tag( util::lookup2( m_state, stateValues ), XMLNS, XMLNS_CHAT_STATES );
   }
 
+  void ChatState::appendXml( std::string& out ) const
+  {
+    if( m_state == ChatStateInvalid )
+      return;
+
+    out += '<';
+    out += util::lookup2( m_state, stateValues );
+    util::appendAttribute( out, "xmlns", XMLNS_CHAT_STATES );
+    out += "/>";
+  }
+
 }
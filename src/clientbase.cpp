@@ -71,6 +71,9 @@
 namespace gloox
 {
 
+  // buffers larger than this are not kept for re-use after sending a big stanza
+  static const std::string::size_type MaxSendBufferSize = 65536;
+
   // ---- ClientBase::Ping ----
   ClientBase::Ping::Ping()
     : StanzaExtension( ExtPing )
@@ -94,12 +97,13 @@ namespace gloox
       m_xmllang( "en" ), m_server( server ), m_compressionActive( false ), m_encryptionActive( false ),
       m_compress( true ), m_authed( false ), m_block( false ), m_sasl( true ), m_tls( TLSOptional ), m_port( port ),
       m_availableSaslMechs( SaslMechAll ),
-      m_statisticsHandler( 0 ), m_mucInvitationHandler( 0 ),
+      m_presenceJidDispatch( 0 ), m_statisticsHandler( 0 ), m_mucInvitationHandler( 0 ),
       m_messageSessionHandlerChat( 0 ), m_messageSessionHandlerGroupchat( 0 ),
       m_messageSessionHandlerHeadline( 0 ), m_messageSessionHandlerNormal( 0 ),
       m_parser( this ), m_seFactory( 0 ), m_authError( AuthErrorUndefined ),
       m_streamError( StreamErrorUndefined ), m_streamErrorAppCondition( 0 ),
-      m_selectedSaslMech( SaslMechNone ), m_autoMessageSession( false )
+      m_selectedSaslMech( SaslMechNone ), m_autoMessageSession( false ),
+      m_lazyStanzas( false ), m_idCount( 0 ), m_idPrefix(), m_iqTimeout( 0 )
   {
     init();
   }
@@ -111,18 +115,32 @@ namespace gloox
       m_xmllang( "en" ), m_server( server ), m_compressionActive( false ), m_encryptionActive( false ),
       m_compress( true ), m_authed( false ), m_block( false ), m_sasl( true ), m_tls( TLSOptional ),
       m_port( port ), m_availableSaslMechs( SaslMechAll ),
-      m_statisticsHandler( 0 ), m_mucInvitationHandler( 0 ),
+      m_presenceJidDispatch( 0 ), m_statisticsHandler( 0 ), m_mucInvitationHandler( 0 ),
       m_messageSessionHandlerChat( 0 ), m_messageSessionHandlerGroupchat( 0 ),
       m_messageSessionHandlerHeadline( 0 ), m_messageSessionHandlerNormal( 0 ),
       m_parser( this ), m_seFactory( 0 ), m_authError( AuthErrorUndefined ),
       m_streamError( StreamErrorUndefined ), m_streamErrorAppCondition( 0 ),
-      m_selectedSaslMech( SaslMechNone ), m_autoMessageSession( false )
+      m_selectedSaslMech( SaslMechNone ), m_autoMessageSession( false ),
+      m_lazyStanzas( false ), m_idCount( 0 ), m_idPrefix(), m_iqTimeout( 0 )
   {
     init();
   }
 
   void ClientBase::init()
   {
+    if( !m_idPrefix[0] )
+    {
+      // tell apart IDs of clients created at the same time or in different runs
+      unsigned int seed = (unsigned int)time( 0 ) ^ (unsigned int)rand();
+      const size_t self = (size_t)this;
+      for( unsigned int i = 0; i < sizeof( self ); ++i )
+        seed = ( seed ^ (unsigned char)( self >> ( i * 8 ) ) ) * 16777619u;
+      memcpy( m_idPrefix, "uid:", 4 );
+      for( int i = 11; i >= 4; --i, seed >>= 4 )
+        m_idPrefix[i] = "0123456789abcdef"[seed & 0xf];
+      m_idPrefix[12] = ':';
+    }
+
     if( !m_disco )
     {
       m_disco = new Disco( this );
@@ -136,7 +154,9 @@ namespace gloox
 
     m_streamError = StreamErrorUndefined;
     m_block = false;
+    m_statisticsMutex.lock();
     memset( &m_stats, 0, sizeof( m_stats ) );
+    m_statisticsMutex.unlock();
     cleanup();
   }
 
@@ -150,11 +170,9 @@ namespace gloox
     delete m_disco;
     m_disco = 0;
 
-    util::clearList( m_messageSessions );
-
-    PresenceJidHandlerList::const_iterator it1 = m_presenceJidHandlers.begin();
-    for( ; it1 != m_presenceJidHandlers.end(); ++it1 )
-      delete (*it1).jid;
+    MessageSessionMap::iterator itms = m_messageSessions.begin();
+    for( ; itms != m_messageSessions.end(); ++itms )
+      util::clearList( (*itms).second );
   }
 
   ConnectionError ClientBase::recv( int timeout )
@@ -162,7 +180,9 @@ namespace gloox
     if( !m_connection || m_connection->state() == StateDisconnected )
       return ConnNotConnected;
 
-    return m_connection->recv( timeout );
+    const ConnectionError ce = m_connection->recv( timeout );
+    checkIqTimeouts();
+    return ce;
   }
 
   bool ClientBase::connect( bool block )
@@ -204,7 +224,7 @@ namespace gloox
     }
 
     logInstance().dbg( LogAreaXmlIncoming, tag->xml() );
-    ++m_stats.totalStanzasReceived;
+    countStanza( m_stats.totalStanzasReceived );
 
     if( tag->name() == "stream" && tag->xmlns() == XMLNS_STREAM )
     {
@@ -233,17 +253,17 @@ namespace gloox
         {
           if( tag->name() == "iq"  )
           {
-            IQ iq( tag );
-            m_seFactory->addExtensions( iq, tag );
+            IQ iq( tag, m_lazyStanzas );
+            addExtensions( iq, tag );
             notifyIqHandlers( iq );
-            ++m_stats.iqStanzasReceived;
+            countStanza( m_stats.iqStanzasReceived );
           }
           else if( tag->name() == "message" )
           {
-            Message msg( tag );
-            m_seFactory->addExtensions( msg, tag );
+            Message msg( tag, m_lazyStanzas );
+            addExtensions( msg, tag );
             notifyMessageHandlers( msg );
-            ++m_stats.messageStanzasReceived;
+            countStanza( m_stats.messageStanzasReceived );
           }
           else if( tag->name() == "presence" )
           {
@@ -251,17 +271,17 @@ namespace gloox
             if( type == "subscribe"  || type == "unsubscribe"
                 || type == "subscribed" || type == "unsubscribed" )
             {
-              Subscription sub( tag );
-              m_seFactory->addExtensions( sub, tag );
+              Subscription sub( tag, m_lazyStanzas );
+              addExtensions( sub, tag );
               notifySubscriptionHandlers( sub );
-              ++m_stats.s10nStanzasReceived;
+              countStanza( m_stats.s10nStanzasReceived );
             }
             else
             {
-              Presence pres( tag );
-              m_seFactory->addExtensions( pres, tag );
+              Presence pres( tag, m_lazyStanzas );
+              addExtensions( pres, tag );
               notifyPresenceHandlers( pres );
-              ++m_stats.presenceStanzasReceived;
+              countStanza( m_stats.presenceStanzasReceived );
             }
           }
           else
@@ -333,6 +353,8 @@ namespace gloox
 
   void ClientBase::handleReceivedData( const ConnectionBase* /*connection*/, const std::string& data )
   {
+    checkIqTimeouts();
+
     if( m_encryption && m_encryptionActive )
       m_encryption->decrypt( data );
     else if( m_compression && m_compressionActive )
@@ -382,14 +404,13 @@ namespace gloox
 
   void ClientBase::parse( const std::string& data )
   {
-    std::string copy = data;
     int i = 0;
-    if( ( i = m_parser.feed( copy ) ) >= 0 )
+    if( ( i = m_parser.feed( data ) ) >= 0 )
     {
       std::string error = "parse error (at pos ";
       error += util::int2string( i );
       error += "): ";
-      m_logInstance.err( LogAreaClassClientbase, error + copy );
+      m_logInstance.err( LogAreaClassClientbase, error + data );
       Tag* e = new Tag( "stream:error" );
       new Tag( e, "restricted-xml", "xmlns", XMLNS_XMPP_STREAM );
       send( e );
@@ -709,59 +730,145 @@ namespace gloox
 #endif
   }
 
-  void ClientBase::send( IQ& iq, IqHandler* ih, int context, bool del )
+  void ClientBase::send( IQ& iq, IqHandler* ih, int context, bool del, int timeout )
   {
     if( ih && ( iq.subtype() == IQ::Set || iq.subtype() == IQ::Get ) )
     {
       if( iq.id().empty() )
         iq.setID( getID() );
 
-      TrackStruct track;
+      if( timeout < 0 )
+        timeout = m_iqTimeout;
+
+      IqTrackShard& shard = iqTrackShard( iq.id() );
+      shard.mutex.lock();
+      TrackStruct& track = shard.handlers[iq.id()];
+      removeIqTimer( shard, track );
       track.ih = ih;
       track.context = context;
       track.del = del;
-      m_iqHandlerMapMutex.lock();
-      m_iqIDHandlers[iq.id()] = track;
-      m_iqHandlerMapMutex.unlock();
+      track.to = iq.to();
+      if( timeout > 0 )
+        addIqTimer( shard, track, iq.id(), timeout );
+      shard.mutex.unlock();
     }
 
     send( iq );
   }
 
+  ClientBase::IqTrackShard& ClientBase::iqTrackShard( const std::string& id )
+  {
+    unsigned int h = 2166136261u;
+    std::string::const_iterator it = id.begin();
+    for( ; it != id.end(); ++it )
+      h = ( h ^ (unsigned char)(*it) ) * 16777619u;
+    return m_iqTracks[( h ^ ( h >> 16 ) ) % IqTrackShards];
+  }
+
+  void ClientBase::addIqTimer( IqTrackShard& shard, TrackStruct& track, const std::string& id,
+                               int timeout )
+  {
+    const time_t now = time( 0 );
+    if( !shard.timerCount )
+      shard.timerTime = now;
+
+    // count from the wheel's current position, which lags behind if no data was received
+    // for a while. the extra tick makes up for the part of the current second that has passed.
+    const long ticks = timeout + 1 + ( now > shard.timerTime ? (long)( now - shard.timerTime ) : 0 );
+
+    IqTimer timer;
+    timer.id = id;
+    timer.rounds = (int)( ( ticks - 1 ) / IqTimerSlots );
+    track.slot = (int)( ( shard.timerSlot + ticks ) % IqTimerSlots );
+    track.timer = shard.timers[track.slot].insert( shard.timers[track.slot].end(), timer );
+    ++shard.timerCount;
+  }
+
+  void ClientBase::removeIqTimer( IqTrackShard& shard, TrackStruct& track )
+  {
+    if( track.slot < 0 )
+      return;
+
+    shard.timers[track.slot].erase( track.timer );
+    track.slot = -1;
+    --shard.timerCount;
+  }
+
+  void ClientBase::checkIqTimeouts()
+  {
+    IqTrackMap expired;
+
+    for( int i = 0; i < IqTrackShards; ++i )
+    {
+      IqTrackShard& shard = m_iqTracks[i];
+      shard.mutex.lock();
+      const time_t now = time( 0 );
+      if( !shard.timerCount )
+        shard.timerTime = now;
+
+      for( ; shard.timerCount && shard.timerTime < now; ++shard.timerTime )
+      {
+        shard.timerSlot = ( shard.timerSlot + 1 ) % IqTimerSlots;
+        IqTimerList& slot = shard.timers[shard.timerSlot];
+        IqTimerList::iterator it = slot.begin();
+        while( it != slot.end() )
+        {
+          if( (*it).rounds )
+          {
+            --(*it).rounds;
+            ++it;
+            continue;
+          }
+
+          IqTrackMap::iterator t = shard.handlers.find( (*it).id );
+          it = slot.erase( it );
+          --shard.timerCount;
+          if( t != shard.handlers.end() )
+          {
+            (*t).second.slot = -1;
+            expired.insert( *t );
+            shard.handlers.erase( t );
+          }
+        }
+      }
+      shard.timerTime = now;
+      shard.mutex.unlock();
+    }
+
+    IqTrackMap::const_iterator it = expired.begin();
+    for( ; it != expired.end(); ++it )
+    {
+      IQ iq( IQ::Error, jid(), (*it).first );
+      iq.setFrom( (*it).second.to );
+      iq.addExtension( new Error( StanzaErrorTypeWait, StanzaErrorRemoteServerTimeout ) );
+      (*it).second.ih->handleIqID( iq, (*it).second.context );
+      if( (*it).second.del )
+        delete (*it).second.ih;
+    }
+  }
+
   void ClientBase::send( const IQ& iq )
   {
-    ++m_stats.iqStanzasSent;
-    Tag* tag = iq.tag();
-    addFrom( tag );
-    addNamespace( tag );
-    send( tag );
+    countStanza( m_stats.iqStanzasSent );
+    sendStanza( iq );
   }
 
   void ClientBase::send( const Message& msg )
   {
-    ++m_stats.messageStanzasSent;
-    Tag* tag = msg.tag();
-    addFrom( tag );
-    addNamespace( tag );
-    send( tag );
+    countStanza( m_stats.messageStanzasSent );
+    sendStanza( msg );
   }
 
   void ClientBase::send( const Subscription& sub )
   {
-    ++m_stats.s10nStanzasSent;
-    Tag* tag = sub.tag();
-    addFrom( tag );
-    addNamespace( tag );
-    send( tag );
+    countStanza( m_stats.s10nStanzasSent );
+    sendStanza( sub );
   }
 
   void ClientBase::send( const Presence& pres )
   {
-    ++m_stats.presenceStanzasSent;
-    Tag* tag = pres.tag();
-    addFrom( tag );
-    addNamespace( tag );
-    send( tag );
+    countStanza( m_stats.presenceStanzasSent );
+    sendStanza( pres );
   }
 
   void ClientBase::send( Tag* tag )
@@ -769,14 +876,63 @@ namespace gloox
     if( !tag )
       return;
 
-    send( tag->xml() );
+    std::string xml;
+    takeSendBuffer( xml );
+    tag->appendXml( xml );
+    send( xml );
+    returnSendBuffer( xml );
+
+    delete tag;
+    stanzaSent();
+  }
+
+  void ClientBase::sendStanza( const Stanza& stanza )
+  {
+    // the stanza is serialized directly, without creating a Tag first. the 'from' and
+    // the namespace are added unless the stanza has its own.
+    std::string xml;
+    takeSendBuffer( xml );
+
+    bool valid;
+    if( !m_authed /*for IQ Auth */ )
+      valid = stanza.appendXml( xml, EmptyString, m_namespace );
+    else if( m_selectedResource.empty() )
+      valid = stanza.appendXml( xml, m_jid.bare(), m_namespace );
+    else
+      valid = stanza.appendXml( xml, m_jid.bare() + '/' + m_selectedResource, m_namespace );
+
+    if( valid )
+      send( xml );
+    returnSendBuffer( xml );
+
+    if( valid )
+      stanzaSent();
+  }
 
-    ++m_stats.totalStanzasSent;
+  void ClientBase::takeSendBuffer( std::string& xml )
+  {
+    // re-use the send buffer's memory. if another thread (or a handler called from
+    // within send()) is using it already, a new buffer is used instead.
+    m_sendBufferMutex.lock();
+    xml.swap( m_sendBuffer );
+    m_sendBufferMutex.unlock();
+  }
+
+  void ClientBase::returnSendBuffer( std::string& xml )
+  {
+    xml.clear();
+    m_sendBufferMutex.lock();
+    if( xml.capacity() <= MaxSendBufferSize && xml.capacity() > m_sendBuffer.capacity() )
+      xml.swap( m_sendBuffer );
+    m_sendBufferMutex.unlock();
+  }
+
+  void ClientBase::stanzaSent()
+  {
+    countStanza( m_stats.totalStanzasSent );
 
     if( m_statisticsHandler )
       m_statisticsHandler->handleStatistics( getStatistics() );
-
-    delete tag;
   }
 
   void ClientBase::send( const std::string& xml )
@@ -794,25 +950,6 @@ namespace gloox
     }
   }
 
-  void ClientBase::addFrom( Tag* tag )
-  {
-    if( !m_authed /*for IQ Auth */ || !tag || tag->hasAttribute( "from" ) )
-      return;
-
-    if ( m_selectedResource.empty() )
-      tag->addAttribute( "from", m_jid.bare() );
-    else
-      tag->addAttribute( "from", m_jid.bare() + '/' + m_selectedResource );
-  }
-
-  void ClientBase::addNamespace( Tag* tag )
-  {
-    if( !tag || !tag->xmlns().empty() )
-      return;
-
-    tag->setXmlns( m_namespace );
-  }
-
   void ClientBase::registerStanzaExtension( StanzaExtension* ext )
   {
     if( !m_seFactory )
@@ -829,12 +966,22 @@ namespace gloox
     return m_seFactory->removeExtension( ext );
   }
 
+  void ClientBase::countStanza( long int& counter )
+  {
+    m_statisticsMutex.lock();
+    ++counter;
+    m_statisticsMutex.unlock();
+  }
+
   StatisticsStruct ClientBase::getStatistics()
   {
+    m_statisticsMutex.lock();
     if( m_connection )
       m_connection->getStatistics( m_stats.totalBytesReceived, m_stats.totalBytesSent );
 
-    return m_stats;
+    StatisticsStruct stats = m_stats;
+    m_statisticsMutex.unlock();
+    return stats;
   }
 
   ConnectionState ClientBase::state() const
@@ -881,11 +1028,21 @@ namespace gloox
 
   const std::string ClientBase::getID()
   {
-    static unsigned int uniqueBaseID = (unsigned int)time( 0 );
-    char r[21+1];
-    sprintf( r, "uid:%08x:%08x", uniqueBaseID, rand() );
-    std::string ret( r, 21 );
-    return ret;
+#if defined( _WIN32 ) || defined( _WIN32_WCE )
+    unsigned long count = (unsigned long)InterlockedIncrement( &m_idCount );
+#elif defined( __GNUC__ ) && ( __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 1 ) )
+    unsigned long count = (unsigned long)__sync_add_and_fetch( &m_idCount, 1 );
+#else
+    m_idMutex.lock();
+    unsigned long count = (unsigned long)++m_idCount;
+    m_idMutex.unlock();
+#endif
+
+    char r[21];
+    memcpy( r, m_idPrefix, 13 );
+    for( int i = 20; i >= 13; --i, count >>= 4 )
+      r[i] = "0123456789abcdef"[count & 0xf];
+    return std::string( r, 21 );
   }
 
   bool ClientBase::checkStreamVersion( const std::string& version )
@@ -1045,43 +1202,46 @@ namespace gloox
   void ClientBase::registerPresenceHandler( const JID& jid, PresenceHandler* ph )
   {
     if( ph && jid )
-    {
-      JidPresHandlerStruct jph;
-      jph.jid = new JID( jid.bare() );
-      jph.ph = ph;
-      m_presenceJidHandlers.push_back( jph );
-    }
+      m_presenceJidHandlers[jid.bare()].push_back( ph );
   }
 
   void ClientBase::removePresenceHandler( const JID& jid, PresenceHandler* ph )
   {
-    PresenceJidHandlerList::iterator t;
-    PresenceJidHandlerList::iterator it = m_presenceJidHandlers.begin();
-    while( it != m_presenceJidHandlers.end() )
-    {
-      t = it;
-      ++it;
-      if( ( !ph || (*t).ph == ph ) && (*t).jid->bare() == jid.bare() )
-      {
-        delete (*t).jid;
-        m_presenceJidHandlers.erase( t );
-      }
-    }
+    PresenceJidHandlerMap::iterator itj = m_presenceJidHandlers.find( jid.bare() );
+    if( itj == m_presenceJidHandlers.end() )
+      return;
+
+    PresenceHandlerList& handlers = (*itj).second;
+    if( ph )
+      handlers.remove( ph );
+    else
+      handlers.clear();
+
+    // the list currently notified is erased by notifyPresenceHandlers() once it is done
+    if( handlers.empty() && &handlers != m_presenceJidDispatch )
+      m_presenceJidHandlers.erase( itj );
   }
 
   void ClientBase::removeIDHandler( IqHandler* ih )
   {
     IqTrackMap::iterator t;
-    m_iqHandlerMapMutex.lock();
-    IqTrackMap::iterator it = m_iqIDHandlers.begin();
-    while( it != m_iqIDHandlers.end() )
+    for( int i = 0; i < IqTrackShards; ++i )
     {
-      t = it;
-      ++it;
-      if( ih == (*t).second.ih )
-        m_iqIDHandlers.erase( t );
+      IqTrackShard& shard = m_iqTracks[i];
+      shard.mutex.lock();
+      IqTrackMap::iterator it = shard.handlers.begin();
+      while( it != shard.handlers.end() )
+      {
+        t = it;
+        ++it;
+        if( ih == (*t).second.ih )
+        {
+          removeIqTimer( shard, (*t).second );
+          shard.handlers.erase( t );
+        }
+      }
+      shard.mutex.unlock();
     }
-    m_iqHandlerMapMutex.unlock();
   }
 
   void ClientBase::registerIqHandler( IqHandler* ih, int exttype )
@@ -1118,7 +1278,7 @@ namespace gloox
   void ClientBase::registerMessageSession( MessageSession* session )
   {
     if( session )
-      m_messageSessions.push_back( session );
+      m_messageSessions[session->target().bare()].push_back( session );
   }
 
   void ClientBase::disposeMessageSession( MessageSession* session )
@@ -1126,13 +1286,18 @@ namespace gloox
     if( !session )
       return;
 
-    MessageSessionList::iterator it = std::find( m_messageSessions.begin(),
-                                                 m_messageSessions.end(),
-                                                 session );
-    if( it != m_messageSessions.end() )
+    MessageSessionMap::iterator b = m_messageSessions.find( session->target().bare() );
+    if( b == m_messageSessions.end() )
+      return;
+
+    MessageSessionList& sessions = (*b).second;
+    MessageSessionList::iterator it = std::find( sessions.begin(), sessions.end(), session );
+    if( it != sessions.end() )
     {
       delete (*it);
-      m_messageSessions.erase( it );
+      sessions.erase( it );
+      if( sessions.empty() )
+        m_messageSessions.erase( b );
     }
   }
 
@@ -1239,7 +1404,11 @@ namespace gloox
     ConnectionListenerList::const_iterator it = m_connectionListeners.begin();
     for( ; it != m_connectionListeners.end() && (*it)->onTLSConnect( info ); ++it )
       ;
-    return m_stats.encryption = ( it == m_connectionListeners.end() );
+    const bool encryption = ( it == m_connectionListeners.end() );
+    m_statisticsMutex.lock();
+    m_stats.encryption = encryption;
+    m_statisticsMutex.unlock();
+    return encryption;
   }
 
   void ClientBase::notifyOnResourceBindError( const Error* error )
@@ -1262,22 +1431,38 @@ namespace gloox
     util::ForEach( m_connectionListeners, &ConnectionListener::onStreamEvent, event );
   }
 
+  void ClientBase::addExtensions( Stanza& stanza, Tag* tag )
+  {
+    if( m_lazyStanzas )
+      stanza.deferExtensions( m_seFactory );
+    else
+      m_seFactory->addExtensions( stanza, tag );
+  }
+
   void ClientBase::notifyPresenceHandlers( Presence& pres )
   {
-    bool match = false;
-    PresenceJidHandlerList::const_iterator t;
-    PresenceJidHandlerList::const_iterator itj = m_presenceJidHandlers.begin();
-    while( itj != m_presenceJidHandlers.end() )
+    PresenceJidHandlerMap::iterator itj = m_presenceJidHandlers.find( pres.from().bare() );
+    if( itj != m_presenceJidHandlers.end() )
     {
-      t = itj++;
-      if( (*t).jid->bare() == pres.from().bare() && (*t).ph )
+      // handlers may remove themselves from within handlePresence()
+      PresenceHandlerList* previous = m_presenceJidDispatch;
+      PresenceHandlerList& handlers = (*itj).second;
+      const bool match = !handlers.empty();
+      m_presenceJidDispatch = &handlers;
+      PresenceHandlerList::const_iterator t;
+      PresenceHandlerList::const_iterator ith = handlers.begin();
+      while( ith != handlers.end() )
       {
-        (*t).ph->handlePresence( pres );
-        match = true;
+        t = ith++;
+        (*t)->handlePresence( pres );
       }
+      m_presenceJidDispatch = previous;
+
+      if( handlers.empty() )
+        m_presenceJidHandlers.erase( itj );
+      if( match )
+        return;
     }
-    if( match )
-      return;
 
     // FIXME remove this for() for 1.1:
     PresenceHandlerList::const_iterator it = m_presenceHandlers.begin();
@@ -1303,18 +1488,31 @@ namespace gloox
 
   void ClientBase::notifyIqHandlers( IQ& iq )
   {
-    m_iqHandlerMapMutex.lock();
-    IqTrackMap::iterator it_id = m_iqIDHandlers.find( iq.id() );
-    m_iqHandlerMapMutex.unlock();
-    if( it_id != m_iqIDHandlers.end() && iq.subtype() & ( IQ::Result | IQ::Error ) )
+    if( iq.subtype() & ( IQ::Result | IQ::Error ) )
     {
-      (*it_id).second.ih->handleIqID( iq, (*it_id).second.context );
-      if( (*it_id).second.del )
-        delete (*it_id).second.ih;
-      m_iqHandlerMapMutex.lock();
-      m_iqIDHandlers.erase( it_id );
-      m_iqHandlerMapMutex.unlock();
-      return;
+      // take the entry out of the tracker before calling the handler: senders on other
+      // threads may modify the shard (and re-use the id) meanwhile
+      TrackStruct track;
+      bool found = false;
+      IqTrackShard& shard = iqTrackShard( iq.id() );
+      shard.mutex.lock();
+      IqTrackMap::iterator it_id = shard.handlers.find( iq.id() );
+      if( it_id != shard.handlers.end() )
+      {
+        removeIqTimer( shard, (*it_id).second );
+        track = (*it_id).second;
+        shard.handlers.erase( it_id );
+        found = true;
+      }
+      shard.mutex.unlock();
+
+      if( found )
+      {
+        track.ih->handleIqID( iq, track.context );
+        if( track.del )
+          delete track.ih;
+        return;
+      }
     }
 
     if( iq.extensions().empty() )
@@ -1373,33 +1571,38 @@ namespace gloox
       }
     }
 
-    MessageSessionList::const_iterator it1 = m_messageSessions.begin();
-    for( ; it1 != m_messageSessions.end(); ++it1 )
+    // only sessions with the sender's bare JID can match, in the order they were registered
+    MessageSessionMap::const_iterator itms = m_messageSessions.find( msg.from().bare() );
+    if( itms != m_messageSessions.end() )
     {
-      if( (*it1)->target().full() == msg.from().full() &&
-            ( msg.thread().empty()
-              || (*it1)->threadID() == msg.thread()
-              || (*it1)->honorThreadID() ) &&
-// FIXME don't use '== 0' here
-            ( (*it1)->types() & msg.subtype() || (*it1)->types() == 0 ) )
+      const MessageSessionList& sessions = (*itms).second;
+      MessageSessionList::const_iterator it1 = sessions.begin();
+      for( ; it1 != sessions.end(); ++it1 )
       {
-        (*it1)->handleMessage( msg );
-        return;
+        if( (*it1)->target().full() == msg.from().full() &&
+              ( msg.thread().empty()
+                || (*it1)->threadID() == msg.thread()
+                || (*it1)->honorThreadID() ) &&
+// FIXME don't use '== 0' here
+              ( (*it1)->types() & msg.subtype() || (*it1)->types() == 0 ) )
+        {
+          (*it1)->handleMessage( msg );
+          return;
+        }
       }
-    }
 
-    it1 = m_messageSessions.begin();
-    for( ; it1 != m_messageSessions.end(); ++it1 )
-    {
-      if( (*it1)->target().bare() == msg.from().bare() &&
-            ( msg.thread().empty()
-              || (*it1)->threadID() == msg.thread()
-              || (*it1)->honorThreadID() ) &&
-// FIXME don't use '== 0' here
-            ( (*it1)->types() & msg.subtype() || (*it1)->types() == 0 ) )
+      it1 = sessions.begin();
+      for( ; it1 != sessions.end(); ++it1 )
       {
-        (*it1)->handleMessage( msg );
-        return;
+        if( ( msg.thread().empty()
+                || (*it1)->threadID() == msg.thread()
+                || (*it1)->honorThreadID() ) &&
+// FIXME don't use '== 0' here
+              ( (*it1)->types() & msg.subtype() || (*it1)->types() == 0 ) )
+        {
+          (*it1)->handleMessage( msg );
+          return;
+        }
       }
     }
 
@@ -32,6 +32,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <ctime>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -165,6 +166,40 @@ namespace gloox
        */
       void setCompression( bool compression ) { m_compress = compression; }
 
+      /**
+       * Switches allocation of incoming stanzas from a per-stanza arena on/off. Default: off.
+       * If switched on, Tags passed to handlers are only valid until the handler returns.
+       * Use Tag::clone() to keep a copy. See Parser::setArena() for details.
+       * @param arena Whether to switch arena allocation on or off.
+       * @since 1.0
+       */
+      void setTagArena( bool arena ) { m_parser.setArena( arena ); }
+
+      /**
+       * Switches lazy decoding of incoming stanzas on/off. Default: off.
+       * If switched on, the addresses, type-specific contents (e.g. a message's body) and
+       * StanzaExtensions of incoming Message, Presence, Subscription and IQ stanzas are
+       * only decoded when they are first accessed. Handlers that, for example, only look
+       * at a stanza's type or id then don't pay for decoding the rest.
+       * A lazily decoded stanza refers to the parsed Tag and is only valid until the handler
+       * returns, which is true for all incoming stanzas anyway.
+       * @param lazy Whether to switch lazy decoding on or off.
+       * @since 1.0
+       */
+      void setLazyStanzaDecoding( bool lazy ) { m_lazyStanzas = lazy; }
+
+      /**
+       * Sets the default number of seconds to wait for the reply to an IQ sent using
+       * send( IQ&, IqHandler*, int, bool, int ). If no reply arrives in time, the IqHandler's
+       * handleIqID() is called with a locally generated IQ of type 'error' (with a
+       * remote-server-timeout condition), and the handler is unregistered (and deleted,
+       * if requested). Timeouts are checked whenever data is received and in recv(), and are
+       * accurate to about a second. Default: 0 (no timeout).
+       * @param timeout The timeout in seconds, or 0 to wait forever.
+       * @since 1.0
+       */
+      void setIqTimeout( int timeout ) { m_iqTimeout = timeout; }
+
       /**
        * Sets the port to connect to. This is not necessary if either the default port (5222) is used
        * or SRV records exist which will be resolved.
@@ -232,7 +267,9 @@ namespace gloox
 
       /**
        * Creates a string which is unique in the current instance and
-       * can be used as an ID for queries.
+       * can be used as an ID for queries. The IDs consist of a random prefix chosen
+       * when the ClientBase is created and a counter. This function is thread-safe
+       * and does not lock on platforms that support atomic increments.
        * @return A unique string suitable for query IDs.
        */
       const std::string getID();
@@ -254,8 +291,10 @@ namespace gloox
        * @param context A value that allows for restoring context.
        * @param del Whether or not delete the IqHandler object after its being called.
        * Default: @b false.
+       * @param timeout The number of seconds to wait for the reply, 0 to wait forever, or -1
+       * to use the default set with setIqTimeout(). Default: -1.
        */
-      void send( IQ& iq, IqHandler* ih, int context, bool del = false );
+      void send( IQ& iq, IqHandler* ih, int context, bool del = false, int timeout = -1 );
 
       /**
        * A convenience function that sends the given IQ stanza.
@@ -501,6 +540,21 @@ namespace gloox
       void registerTagHandler( TagHandler* th, const std::string& tag,
                                                const std::string& xmlns );
 
+      /**
+       * Registers @c teh to receive the contents of incoming elements with the given name and
+       * namespace as events instead of as Tags. This is useful for stanzas that can get very
+       * large, e.g. a roster or a pubsub items result: the matching element is still part of
+       * the stanza passed to the other handlers, but it arrives there without any children.
+       * See Parser::registerEventHandler() for details.
+       * @param teh The object to receive the events.
+       * @param tag The element's name.
+       * @param xmlns The element's namespace.
+       * @since 1.0
+       */
+      void registerTagEventHandler( TagEventHandler* teh, const std::string& tag,
+                                    const std::string& xmlns )
+        { m_parser.registerEventHandler( teh, tag, xmlns ); }
+
       /**
        * Registers @c sh as object that receives up-to-date connection statistics each time
        * a Stanza is received or sent. Alternatively, you can use getStatistics() manually.
@@ -553,6 +607,13 @@ namespace gloox
       void removeTagHandler( TagHandler* th, const std::string& tag,
                                              const std::string& xmlns );
 
+      /**
+       * Removes all registrations of the given TagEventHandler.
+       * @param teh The object to remove.
+       * @since 1.0
+       */
+      void removeTagEventHandler( TagEventHandler* teh ) { m_parser.removeEventHandler( teh ); }
+
       /**
        * Removes the current StatisticsHandler.
        */
@@ -894,6 +955,14 @@ namespace gloox
             return new Tag( "ping", "xmlns", XMLNS_XMPP_PING );
           }
 
+          // reimplemented from StanzaExtension
+          virtual void appendXml( std::string& out ) const
+          {
+            out += "<ping xmlns='";
+            out += XMLNS_XMPP_PING;
+            out += "'/>";
+          }
+
           // reimplemented from StanzaExtension
           virtual StanzaExtension* clone() const
           {
@@ -927,14 +996,18 @@ namespace gloox
       CompressionBase* getDefaultCompression();
 
       void notifyIqHandlers( IQ& iq );
+      void addExtensions( Stanza& stanza, Tag* tag );
       void notifyMessageHandlers( Message& msg );
       void notifyPresenceHandlers( Presence& presence );
       void notifySubscriptionHandlers( Subscription& s10n );
       void notifyTagHandlers( Tag* tag );
       void notifyOnDisconnect( ConnectionError e );
       void send( const std::string& xml );
-      void addFrom( Tag* tag );
-      void addNamespace( Tag* tag );
+      void sendStanza( const Stanza& stanza );
+      void takeSendBuffer( std::string& xml );
+      void returnSendBuffer( std::string& xml );
+      void stanzaSent();
+      void countStanza( long int& counter );
 
       // reimplemented from IqHandler
       virtual bool handleIq( const IQ& iq );
@@ -942,13 +1015,28 @@ namespace gloox
       // reimplemented from IqHandler
       virtual void handleIqID( const IQ& iq, int context );
 
+      // an entry of the IQ timeout wheel: the tracked IQ's id and the number of turns of
+      // the wheel to wait before it expires
+      struct IqTimer
+      {
+        std::string id;
+        int rounds;
+      };
+      typedef std::list<IqTimer> IqTimerList;
+      static const int IqTimerSlots = 64;   // one slot per second
+
       struct TrackStruct
       {
+        TrackStruct() : ih( 0 ), context( 0 ), del( false ), slot( -1 ) {}
         IqHandler* ih;
         int context;
         bool del;
+        JID to;
+        int slot;                     // the IqTimer's slot, -1 if the IQ doesn't time out
+        IqTimerList::iterator timer;
       };
 
+
       struct TagHandlerStruct
       {
         TagHandler* th;
@@ -956,12 +1044,6 @@ namespace gloox
         std::string tag;
       };
 
-      struct JidPresHandlerStruct
-      {
-        JID* jid;
-        PresenceHandler* ph;
-      };
-
       enum TrackContext
       {
         XMPPPing
@@ -973,23 +1055,45 @@ namespace gloox
       typedef std::map<const std::string, TrackStruct>     IqTrackMap;
       typedef std::map<const std::string, MessageHandler*> MessageHandlerMap;
       typedef std::list<MessageSession*>                   MessageSessionList;
+      typedef std::map<const std::string, MessageSessionList> MessageSessionMap;
       typedef std::list<MessageHandler*>                   MessageHandlerList;
       typedef std::list<PresenceHandler*>                  PresenceHandlerList;
-      typedef std::list<JidPresHandlerStruct>              PresenceJidHandlerList;
+      typedef std::map<const std::string, PresenceHandlerList> PresenceJidHandlerMap;
       typedef std::list<SubscriptionHandler*>              SubscriptionHandlerList;
       typedef std::list<TagHandlerStruct>                  TagHandlerList;
 
+      // the tracked IQs are spread over several shards by id, each with its own lock and
+      // timeout wheel, so that threads sending IQs rarely wait for each other or for the
+      // thread resolving the replies
+      struct IqTrackShard
+      {
+        IqTrackShard() : timerSlot( 0 ), timerCount( 0 ), timerTime( 0 ) {}
+        util::Mutex mutex;
+        IqTrackMap handlers;
+        IqTimerList timers[IqTimerSlots];
+        int timerSlot;                // the slot handled last
+        int timerCount;
+        time_t timerTime;             // the time timerSlot was handled at
+      };
+      static const int IqTrackShards = 16;
+
+      IqTrackShard& iqTrackShard( const std::string& id );
+      static void addIqTimer( IqTrackShard& shard, TrackStruct& track, const std::string& id,
+                              int timeout );
+      static void removeIqTimer( IqTrackShard& shard, TrackStruct& track );
+      void checkIqTimeouts();
+
       ConnectionListenerList   m_connectionListeners;
       IqHandlerMapXmlns        m_iqNSHandlers;
       IqHandlerMap             m_iqExtHandlers;
-      IqTrackMap               m_iqIDHandlers;
-      MessageSessionList       m_messageSessions;
+      MessageSessionMap        m_messageSessions; // by the target's bare JID, which does not change
       MessageHandlerList       m_messageHandlers;
       PresenceHandlerList      m_presenceHandlers;
-      PresenceJidHandlerList   m_presenceJidHandlers;
+      PresenceJidHandlerMap    m_presenceJidHandlers; // by bare JID
       SubscriptionHandlerList  m_subscriptionHandlers;
       TagHandlerList           m_tagHandlers;
       StringList               m_cacerts;
+      PresenceHandlerList    * m_presenceJidDispatch; // the handlers notifyPresenceHandlers() walks
       StatisticsHandler      * m_statisticsHandler;
       MUCInvitationHandler   * m_mucInvitationHandler;
       MessageSessionHandler  * m_messageSessionHandlerChat;
@@ -997,7 +1101,11 @@ namespace gloox
       MessageSessionHandler  * m_messageSessionHandlerHeadline;
       MessageSessionHandler  * m_messageSessionHandlerNormal;
 
-      util::Mutex m_iqHandlerMapMutex;
+      util::Mutex m_sendBufferMutex;
+      util::Mutex m_statisticsMutex;  // guards m_stats, which senders on any thread update
+      util::Mutex m_idMutex;      // used by getID() if atomic increments are not available
+
+      std::string m_sendBuffer;
 
       Parser m_parser;
       LogSink m_logInstance;
@@ -1016,6 +1124,13 @@ namespace gloox
 
       std::string m_ntlmDomain;
       bool m_autoMessageSession;
+      bool m_lazyStanzas;
+
+      volatile long m_idCount;
+      char m_idPrefix[13];        // 'uid:' and 8 random hex digits and ':'
+
+      IqTrackShard m_iqTracks[IqTrackShards];
+      int m_iqTimeout;
 
 #ifdef _WIN32
       CredHandle m_credHandle;
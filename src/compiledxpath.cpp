@@ -0,0 +1,90 @@
+/*
+  Copyright (c) 2009 by Jakob Schroeter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#include "compiledxpath.h"
+#include "tag.h"
+#include "mutex.h"
+#include "mutexguard.h"
+
+#include <map>
+
+namespace gloox
+{
+
+  CompiledXPath::CompiledXPath( const std::string& expression )
+    : m_expression( expression ), m_root( 0 ), m_absolute( false )
+  {
+    if( expression == "/" || expression == "//" )
+      return;
+
+    m_absolute = expression.length() >= 2 && expression[0] == '/' && expression[1] != '/';
+
+    unsigned len = 0;
+    m_root = Tag::parse( expression, len );
+  }
+
+  CompiledXPath::~CompiledXPath()
+  {
+    delete m_root;
+  }
+
+  /*
+   * The process-wide cache of compiled expressions. Entries are never removed, so
+   * pointers handed out stay valid until the program exits.
+   */
+  class XPathCache
+  {
+    public:
+      XPathCache() {}
+
+      ~XPathCache()
+      {
+        XPathMap::iterator it = m_xpaths.begin();
+        for( ; it != m_xpaths.end(); ++it )
+          delete (*it).second;
+      }
+
+      const CompiledXPath* get( const std::string& expression )
+      {
+        util::MutexGuard m( m_mutex );
+
+        XPathMap::const_iterator it = m_xpaths.find( expression );
+        if( it != m_xpaths.end() )
+          return (*it).second;
+
+        if( m_xpaths.size() >= MaxSize )
+          return 0;
+
+        CompiledXPath* xp = new CompiledXPath( expression );
+        m_xpaths.insert( std::make_pair( expression, xp ) );
+        return xp;
+      }
+
+    private:
+      typedef std::map<std::string, CompiledXPath*> XPathMap;
+
+      static const XPathMap::size_type MaxSize = 256;
+
+      XPathMap m_xpaths;
+      util::Mutex m_mutex;
+  };
+
+  // constructed during static initialization, before any thread can use it
+  static XPathCache xpathCache;
+
+  const CompiledXPath* CompiledXPath::cached( const std::string& expression )
+  {
+    return xpathCache.get( expression );
+  }
+
+}
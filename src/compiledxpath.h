@@ -0,0 +1,84 @@
+/*
+  Copyright (c) 2009 by Jakob Schroeter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef COMPILEDXPATH_H__
+#define COMPILEDXPATH_H__
+
+#include "macros.h"
+
+#include <string>
+
+namespace gloox
+{
+
+  class Tag;
+
+  /**
+   * @brief A pre-parsed XPath expression that can be evaluated against any number of Tags.
+   *
+   * Tag::findTagList( const std::string& ) and friends have to parse their expression
+   * before evaluating it. If the same expression is used over and over again, e.g. as a
+   * StanzaExtension's filter string, create a CompiledXPath once and pass it to
+   * Tag::findTagList( const CompiledXPath& ) instead.
+   *
+   * Evaluating a CompiledXPath does not modify it, so a single instance may be used from
+   * several threads at once.
+   *
+   * @author Jakob Schroeter <js@camaya.net>
+   * @since 1.0
+   */
+  class GLOOX_API CompiledXPath
+  {
+    public:
+      /**
+       * Parses the given XPath expression.
+       * @param expression The XPath expression.
+       */
+      CompiledXPath( const std::string& expression );
+
+      /**
+       * Destructor.
+       */
+      ~CompiledXPath();
+
+      /**
+       * Returns the original expression.
+       * @return The original expression.
+       */
+      const std::string& expression() const { return m_expression; }
+
+      /**
+       * Returns a CompiledXPath for the given expression from a process-wide cache, parsing
+       * and adding the expression if necessary. Cached expressions live until the program
+       * exits. To keep memory use bounded, the cache accepts only a limited number of
+       * expressions; once it is full, 0 is returned for expressions not already in it.
+       * @param expression The XPath expression.
+       * @return The cached CompiledXPath, or 0 if the cache is full.
+       */
+      static const CompiledXPath* cached( const std::string& expression );
+
+    private:
+      CompiledXPath( const CompiledXPath& );
+      CompiledXPath& operator=( const CompiledXPath& );
+
+      friend class Tag;
+
+      std::string m_expression;
+      Tag* m_root;
+      bool m_absolute;
+
+  };
+
+}
+
+#endif // COMPILEDXPATH_H__
@@ -406,8 +406,7 @@ namespace gloox
       {
         putConnection();
         --m_openRequests;
-        std::string xml = m_buffer.substr( headerLength + 4, m_bufferContentLength );
-        m_parser.feed( xml );
+        m_parser.feed( m_buffer.data() + headerLength + 4, m_bufferContentLength );
         m_buffer.erase( 0, headerLength + 4 + m_bufferContentLength );
         m_bufferContentLength = 0;
         m_bufferHeader = EmptyString;
@@ -554,10 +553,15 @@ namespace gloox
       return;
     }
 
+    std::string xml;
     const TagList& stanzas = tag->children();
     TagList::const_iterator it = stanzas.begin();
     for( ; it != stanzas.end(); ++it )
-      m_handler->handleReceivedData( this, (*it)->xml() );
+    {
+      xml.clear();
+      (*it)->appendXml( xml );
+      m_handler->handleReceivedData( this, xml );
+    }
   }
 
   ConnectionBase* ConnectionBOSH::getConnection()
@@ -14,6 +14,7 @@
 #include "delayeddelivery.h"
 
 #include "tag.h"
+#include "util.h"
 
 namespace gloox
 {
@@ -71,4 +72,25 @@ namespace gloox
     return t;
   }
 
+  void DelayedDelivery::appendXml( std::string& out ) const
+  {
+    if( !m_valid )
+      return;
+
+    out += "<delay";
+    util::appendAttribute( out, "xmlns", XMLNS_DELAY );
+    if( m_from )
+      util::appendAttribute( out, "from", m_from.full() );
+    util::appendAttribute( out, "stamp", m_stamp );
+    if( m_reason.empty() || !util::checkValidXMLChars( m_reason ) )
+    {
+      out += "/>";
+      return;
+    }
+
+    out += '>';
+    util::appendEscaped( out, m_reason );
+    out += "</delay>";
+  }
+
 }
@@ -54,14 +54,17 @@ namespace gloox
     "unknown-sender"
   };
 
+  static const util::LookupTable errTable( errValues );
+  static const util::LookupTable stanzaErrTable( stanzaErrValues );
+
   static inline StanzaErrorType stanzaErrorType( const std::string& type )
   {
-    return (StanzaErrorType)util::lookup( type, errValues );
+    return (StanzaErrorType)errTable.find( type );
   }
 
   static inline StanzaError stanzaError( const std::string& type )
   {
-    return (StanzaError)util::lookup( type, stanzaErrValues );
+    return (StanzaError)stanzaErrTable.find( type );
   }
 
   Error::Error( const Tag* tag )
@@ -129,6 +132,40 @@ namespace gloox
     return error;
   }
 
+  void Error::appendXml( std::string& out ) const
+  {
+    if( m_type == StanzaErrorTypeUndefined || m_error == StanzaErrorUndefined )
+      return;
+
+    out += "<error";
+    util::appendAttribute( out, "type", util::lookup( m_type, errValues ) );
+    out += "><";
+    out += util::lookup( m_error, stanzaErrValues );
+    util::appendAttribute( out, "xmlns", XMLNS_XMPP_STANZAS );
+    out += "/>";
+
+    StringMap::const_iterator it = m_text.begin();
+    for( ; it != m_text.end(); ++it )
+    {
+      out += "<text";
+      util::appendAttribute( out, "xmlns", XMLNS_XMPP_STANZAS );
+      util::appendAttribute( out, "xml:lang", (*it).first );
+      if( (*it).second.empty() || !util::checkValidXMLChars( (*it).second ) )
+        out += "/>";
+      else
+      {
+        out += '>';
+        util::appendEscaped( out, (*it).second );
+        out += "</text>";
+      }
+    }
+
+    if( m_appError )
+      m_appError->appendXml( out );
+
+    out += "</error>";
+  }
+
   const std::string& Error::text( const std::string& lang ) const
   {
     StringMap::const_iterator it = m_text.find( lang );
@@ -117,6 +117,9 @@ namespace gloox
       // reimplemented from StanzaExtension
       virtual Tag* tag() const;
 
+      // reimplemented from StanzaExtension
+      virtual void appendXml( std::string& out ) const;
+
       // reimplemented from StanzaExtension
       virtual StanzaExtension* clone() const
       {
@@ -21,18 +21,22 @@ namespace gloox
     "get", "set", "result", "error"
   };
 
+  static const util::LookupTable iqTypeTable( iqTypeStringValues );
+
   static inline const char* typeString( IQ::IqType type )
   {
     return iqTypeStringValues[type];
   }
 
-  IQ::IQ( Tag* tag )
-    : Stanza( tag ), m_subtype( Invalid )
+  IQ::IQ( Tag* tag, bool lazy )
+    : Stanza( tag, lazy ), m_subtype( Invalid )
   {
+    m_pending &= ~PendingPayload;
+
     if( !tag || tag->name() != "iq" )
       return;
 
-    m_subtype = (IQ::IqType)util::lookup( tag->findAttribute( TYPE ), iqTypeStringValues );
+    m_subtype = (IQ::IqType)iqTypeTable.find( tag->findAttribute( TYPE ) );
   }
 
   IQ::IQ( IqType type, const JID& to, const std::string& id )
@@ -51,19 +55,36 @@ namespace gloox
       return 0;
 
     Tag* t = new Tag( "iq" );
-    if( m_to )
+    if( to() )
       t->addAttribute( "to", m_to.full() );
-    if( m_from )
+    if( from() )
       t->addAttribute( "from", m_from.full() );
     if( !m_id.empty() )
       t->addAttribute( "id", m_id );
     t->addAttribute( TYPE, typeString( m_subtype ) );
 
-    StanzaExtensionList::const_iterator it = m_extensionList.begin();
+    StanzaExtensionList::const_iterator it = extensions().begin();
     for( ; it != m_extensionList.end(); ++it )
       t->addChild( (*it)->tag() );
 
     return t;
   }
 
+  bool IQ::appendXml( std::string& out, const std::string& from, const std::string& xmlns ) const
+  {
+    if( m_subtype == Invalid )
+      return false;
+
+    out += "<iq";
+    appendAddresses( out );
+    appendAttribute( out, "id", m_id );
+    appendAttribute( out, "type", typeString( m_subtype ) );
+    appendStartTagEnd( out, from, xmlns );
+    const std::string::size_type contents = out.length();
+
+    appendExtensions( out );
+    appendEndTag( out, contents, "iq" );
+    return true;
+  }
+
 }
@@ -76,6 +76,10 @@ namespace gloox
       // reimplemented from Stanza
       virtual Tag* tag() const;
 
+      // reimplemented from Stanza
+      virtual bool appendXml( std::string& out, const std::string& from = EmptyString,
+                              const std::string& xmlns = EmptyString ) const;
+
     private:
 #ifdef IQ_TEST
     public:
@@ -84,7 +88,7 @@ namespace gloox
        * Creates an IQ from a tag. The original Tag will be ripped off.
        * @param tag The Tag to parse.
        */
-      IQ( Tag* tag );
+      IQ( Tag* tag, bool lazy = false );
 
       void setID( const std::string& id ) { m_id = id; }
 
@@ -21,22 +21,35 @@ namespace gloox
     "chat", "error", "groupchat", "headline", "normal"
   };
 
+  static const util::LookupTable msgTypeTable( msgTypeStringValues );
+
   static inline const std::string typeString( Message::MessageType type )
   {
     return util::lookup2( type, msgTypeStringValues );
   }
 
-  Message::Message( Tag* tag )
-    : Stanza( tag ), m_subtype( Invalid ), m_bodies( 0 ), m_subjects( 0 )
+  Message::Message( Tag* tag, bool lazy )
+    : Stanza( tag, lazy ), m_subtype( Invalid ), m_bodies( 0 ), m_subjects( 0 )
   {
     if( !tag || tag->name() != "message" )
+    {
+      m_pending &= ~PendingPayload;
       return;
+    }
 
     const std::string& typestring = tag->findAttribute( TYPE );
     if( typestring.empty() )
       m_subtype = Normal;
     else
-      m_subtype = (MessageType)util::lookup2( typestring, msgTypeStringValues );
+      m_subtype = (MessageType)msgTypeTable.find2( typestring );
+
+    if( !lazy )
+      parsePayload( tag );
+  }
+
+  void Message::parsePayload( const Tag* tag )
+  {
+    m_pending &= ~PendingPayload;
 
     const TagList& c = tag->children();
     TagList::const_iterator it = c.begin();
@@ -71,10 +84,12 @@ namespace gloox
     if( m_subtype == Invalid )
       return 0;
 
+    decode();
+
     Tag* t = new Tag( "message" );
-    if( m_to )
+    if( to() )
       t->addAttribute( "to", m_to.full() );
-    if( m_from )
+    if( from() )
       t->addAttribute( "from", m_from.full() );
     if( !m_id.empty() )
       t->addAttribute( "id", m_id );
@@ -86,11 +101,37 @@ namespace gloox
     if( !m_thread.empty() )
       new Tag( t, "thread", m_thread );
 
-    StanzaExtensionList::const_iterator it = m_extensionList.begin();
+    StanzaExtensionList::const_iterator it = extensions().begin();
     for( ; it != m_extensionList.end(); ++it )
       t->addChild( (*it)->tag() );
 
     return t;
   }
 
+  bool Message::appendXml( std::string& out, const std::string& from,
+                           const std::string& xmlns ) const
+  {
+    if( m_subtype == Invalid )
+      return false;
+
+    decode();
+
+    out += "<message";
+    appendAddresses( out );
+    appendAttribute( out, "id", m_id );
+    appendAttribute( out, "type", typeString( m_subtype ) );
+    appendStartTagEnd( out, from, xmlns );
+    const std::string::size_type contents = out.length();
+
+    appendLangs( m_bodies, m_body, "body", out );
+    appendLangs( m_subjects, m_subject, "subject", out );
+
+    if( !m_thread.empty() )
+      appendElement( out, "thread", m_thread );
+
+    appendExtensions( out );
+    appendEndTag( out, contents, "message" );
+    return true;
+  }
+
 }
@@ -85,6 +85,7 @@ namespace gloox
        */
       const std::string body( const std::string& lang = "default" ) const
       {
+        decode();
         return findLang( m_bodies, m_body, lang );
       }
 
@@ -99,6 +100,7 @@ namespace gloox
        */
       const std::string subject( const std::string& lang = "default" ) const
       {
+        decode();
         return findLang( m_subjects, m_subject, lang );
       }
 
@@ -106,13 +108,13 @@ namespace gloox
        * Returns the thread ID of a message stanza.
        * @return The thread ID of a message stanza. Empty for non-message stanzas.
        */
-      const std::string& thread() const { return m_thread; }
+      const std::string& thread() const { decode(); return m_thread; }
 
       /**
        * Sets the thread ID.
        * @param thread The thread ID.
        */
-      void setThread( const std::string& thread ) { m_thread = thread; }
+      void setThread( const std::string& thread ) { decode(); m_thread = thread; }
 
       /**
        * Sets the message's ID. Optional.
@@ -133,6 +135,10 @@ namespace gloox
       // reimplemented from Stanza
       virtual Tag* tag() const;
 
+      // reimplemented from Stanza
+      virtual bool appendXml( std::string& out, const std::string& from = EmptyString,
+                              const std::string& xmlns = EmptyString ) const;
+
     private:
 #ifdef MESSAGE_TEST
     public:
@@ -141,7 +147,11 @@ namespace gloox
        * Creates a message Stanza from the given Tag. The original Tag will be ripped off.
        * @param tag The Tag to parse.
        */
-      Message( Tag* tag );
+      Message( Tag* tag, bool lazy = false );
+
+      void decode() const
+        { if( m_pending & PendingPayload ) const_cast<Message*>( this )->parsePayload( m_source ); }
+      void parsePayload( const Tag* tag );
 
       MessageType m_subtype;
       std::string m_body;
@@ -44,6 +44,9 @@ namespace gloox
     "moderator",
   };
 
+  static const util::LookupTable affiliationTable( affiliationValues );
+  static const util::LookupTable roleTable( roleValues );
+
   /** Strings indicating the type of history to request. */
   const char* historyTypeValues[] =
   {
@@ -52,12 +55,12 @@ namespace gloox
 
   static inline MUCRoomAffiliation affiliationType( const std::string& type )
   {
-    return (MUCRoomAffiliation)util::lookup( type, affiliationValues );
+    return (MUCRoomAffiliation)affiliationTable.find( type );
   }
 
   static inline MUCRoomRole roleType( const std::string& type )
   {
-    return (MUCRoomRole)util::lookup( type, roleValues );
+    return (MUCRoomRole)roleTable.find( type );
   }
 
   MUCRoom::MUCAdmin::MUCAdmin( MUCRoomRole role, const std::string& nick,
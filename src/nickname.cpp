@@ -12,6 +12,7 @@
 
 #include "nickname.h"
 #include "tag.h"
+#include "util.h"
 
 namespace gloox
 {
@@ -41,4 +42,22 @@ namespace gloox
     return n;
   }
 
+  void Nickname::appendXml( std::string& out ) const
+  {
+    if( m_nick.empty() )
+      return;
+
+    out += "<nick";
+    util::appendAttribute( out, "xmlns", XMLNS_NICKNAME );
+    if( !util::checkValidXMLChars( m_nick ) )
+    {
+      out += "/>";
+      return;
+    }
+
+    out += '>';
+    util::appendEscaped( out, m_nick );
+    out += "</nick>";
+  }
+
 }
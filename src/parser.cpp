@@ -13,55 +13,120 @@
 #include "gloox.h"
 #include "util.h"
 #include "parser.h"
+#include "tagarena.h"
 
 #include <cstdlib>
 
 namespace gloox
 {
 
+  static const char* CDATAOpening = "![CDATA[";
+  static const int CDATAOpeningLength = 8;
+
+  static const char TextStops[] = { '<', '&' };
+  static const char ValueStops[] = { '<', '&', '\'', '"' };
+  static const char CDATAStops[] = { ']' };
+
+  /*
+   * Appends the run of bytes starting at pos up to (but excluding) the next stop byte
+   * to target. Returns the position of the last byte consumed.
+   */
+  static inline std::string::size_type appendRun( std::string& target, const char* data,
+                                                  std::string::size_type pos,
+                                                  std::string::size_type length,
+                                                  const char* stops, unsigned numStops )
+  {
+    const std::string::size_type run = util::findFirstOf( data + pos, length - pos, stops, numStops );
+    target.append( data + pos, run );
+    return pos + run - 1;
+  }
+
   Parser::Parser( TagHandler* ph, bool deleteRoot )
-    : m_tagHandler( ph ), m_current( 0 ), m_root( 0 ), m_xmlnss( 0 ), m_state( Initial ),
-      m_preamble( 0 ), m_quote( false ), m_haveTagPrefix( false ), m_haveAttribPrefix( false ),
-      m_attribIsXmlns( false ), m_deleteRoot( deleteRoot )
+    : m_tagHandler( ph ), m_arena( 0 ), m_stanzaArena( 0 ), m_current( 0 ), m_root( 0 ), m_declarations( 0 ),
+      m_eventHandler( 0 ), m_activeHandler( 0 ), m_eventDepth( 0 ), m_viewHandler( 0 ), m_chunk( 0 ),
+      m_pos( 0 ), m_rawBase( 0 ), m_tagStart( 0 ), m_attribStart( 0 ), m_valueStart( 0 ),
+      m_rawActive( false ), m_viewing( false ), m_state( Initial ),
+      m_entityState( Initial ), m_marker( 0 ), m_preamble( 0 ), m_quote( false ), m_haveTagPrefix( false ), m_haveAttribPrefix( false ),
+      m_attribIsXmlns( false ), m_deleteRoot( deleteRoot ), m_useArena( false )
   {
   }
 
   Parser::~Parser()
   {
-    delete m_root;
-    delete m_xmlnss;
+    cleanup();
+    delete m_arena;
   }
 
-  Parser::DecodeState Parser::decode( std::string::size_type& pos, const std::string& data )
+  void Parser::setArena( bool arena )
   {
-    std::string::size_type p = data.find( ';', pos );
-    std::string::size_type diff = p - pos;
+    m_useArena = arena;
+    if( m_useArena && !m_arena )
+      m_arena = new TagArena();
+  }
+
+  void Parser::registerEventHandler( TagEventHandler* teh, const std::string& tag,
+                                     const std::string& xmlns )
+  {
+    if( !teh || tag.empty() )
+      return;
+
+    EventHandlerEntry e;
+    e.handler = teh;
+    e.tag = tag;
+    e.xmlns = xmlns;
+    m_eventHandlers.push_back( e );
+  }
 
-    if( p == std::string::npos )
+  void Parser::removeEventHandler( TagEventHandler* teh )
+  {
+    EventHandlerList::iterator it = m_eventHandlers.begin();
+    while( it != m_eventHandlers.end() )
     {
-      m_backBuffer = data.substr( pos );
-      return DecodeInsufficient;
+      if( (*it).handler == teh )
+        it = m_eventHandlers.erase( it );
+      else
+        ++it;
     }
 
+    if( m_activeHandler == teh )
+      m_activeHandler = 0;
+  }
+
+  TagArena* Parser::arena()
+  {
+    // attributes reported as events are short-lived, don't let them pile up in the arena
+    if( m_eventDepth || ( m_eventHandler && !m_root ) )
+      return 0;
+
+    if( !m_stanzaArena && !m_root && m_attribs.empty() && m_useArena && m_deleteRoot )
+      m_stanzaArena = m_arena;
+
+    return m_stanzaArena;
+  }
+
+  Parser::DecodeState Parser::decode( const std::string& entity )
+  {
+    const std::string::size_type diff = entity.length() - 1;
+
     if( diff < 3 || diff > 9 )
       return DecodeInvalid;
 
     std::string rep;
-    switch( data[pos + 1] )
+    switch( entity[1] )
     {
       case '#':
         {
           int base = 10;
           int idx = 2;
 
-          if( data[pos + 2] == 'x' || data[pos + 2] == 'X' )
+          if( entity[2] == 'x' || entity[2] == 'X' )
           {
             base = 16;
             idx = 3;
           }
 
           char* end;
-          const long int val = std::strtol( data.data() + pos + idx, &end, base );
+          const long int val = std::strtol( entity.c_str() + idx, &end, base );
           if( *end != ';' || val < 0 )
             return DecodeInvalid;
 
@@ -92,27 +157,27 @@ namespace gloox
         }
         break;
       case 'l':
-        if( diff == 3 && data[pos + 2] == 't' )
+        if( diff == 3 && entity[2] == 't' )
           rep += '<';
         else
           return DecodeInvalid;
         break;
       case 'g':
-        if( diff == 3 && data[pos + 2] == 't' )
+        if( diff == 3 && entity[2] == 't' )
           rep += '>';
         else
           return DecodeInvalid;
         break;
       case 'a':
-        if( diff == 5 && !data.compare( pos + 1, 5, "apos;" ) )
+        if( diff == 5 && !entity.compare( 1, 5, "apos;" ) )
           rep += '\'';
-        else if( diff == 4 && !data.compare( pos + 1, 4, "amp;" ) )
+        else if( diff == 4 && !entity.compare( 1, 4, "amp;" ) )
           rep += '&';
         else
           return DecodeInvalid;
         break;
       case 'q':
-        if( diff == 5 && !data.compare( pos + 1, 5, "quot;" ) )
+        if( diff == 5 && !entity.compare( 1, 5, "quot;" ) )
           rep += '"';
         else
           return DecodeInvalid;
@@ -121,7 +186,7 @@ namespace gloox
         return DecodeInvalid;
     }
 
-    switch( m_state )
+    switch( m_entityState )
     {
       case TagInside:
         m_cdata += rep;
@@ -132,44 +197,23 @@ namespace gloox
       default:
         break;
     }
-    pos += diff;
     return DecodeValid;
   }
 
-  Parser::ForwardScanState Parser::forwardScan( std::string::size_type& pos, const std::string& data,
-                                                const std::string& needle )
+  int Parser::feed( const std::string& data )
   {
-    if( pos + needle.length() <= data.length() )
-    {
-      if( !data.compare( pos, needle.length(), needle ) )
-      {
-        pos += needle.length() - 1;
-        return ForwardFound;
-      }
-      else
-      {
-        return ForwardNotFound;
-      }
-    }
-    else
-    {
-      m_backBuffer = data.substr( pos );
-      return ForwardInsufficientSize;
-    }
+    return feed( data.data(), data.length() );
   }
 
-  int Parser::feed( std::string& data )
+  int Parser::feed( const char* data, std::string::size_type length )
   {
-    if( !m_backBuffer.empty() )
-    {
-      data.insert( 0, m_backBuffer );
-      m_backBuffer = EmptyString;
-    }
+    m_chunk = data;
+    m_rawBase = 0;
 
-    std::string::size_type count = data.length();
-    for( std::string::size_type i = 0; i < count; ++i )
+    for( std::string::size_type i = 0; i < length; ++i )
     {
       const unsigned char c = data[i];
+      m_pos = i;
 //       printf( "found char:   %c, ", c );
 
       if( !isValid( c ) )
@@ -188,6 +232,7 @@ namespace gloox
           switch( c )
           {
             case '<':
+              startView( i );
               m_state = TagOpening;
               break;
             default:
@@ -205,11 +250,12 @@ namespace gloox
           switch( c )
           {
             case '<':
+              startView( i );
               m_state = TagOpening;
               break;
             case '>':
             default:
-              if( m_current )
+              if( m_current || m_eventDepth )
               {
                 m_cdata += c;
                 m_state = TagInside;
@@ -238,17 +284,8 @@ namespace gloox
               m_preamble = 1;
               break;
             case '!':
-              switch( forwardScan( i, data, "![CDATA[" ) )
-              {
-                case ForwardFound:
-                  m_state = TagCDATASection;
-                  break;
-                case ForwardNotFound:
-                  cleanup();
-                  return static_cast<int>( i );
-                case ForwardInsufficientSize:
-                  return -1;
-              }
+              m_marker = 1;
+              m_state = TagCDATAOpening;
               break;
             default:
               m_tag += c;
@@ -256,27 +293,61 @@ namespace gloox
               break;
           }
           break;
+        case TagCDATAOpening:         // we're matching the remainder of '<![CDATA['
+          if( c != CDATAOpening[m_marker] )
+          {
+            cleanup();
+            return static_cast<int>( i );
+          }
+
+          if( ++m_marker == CDATAOpeningLength )
+          {
+            m_marker = 0;
+            m_state = TagCDATASection;
+          }
+          break;
         case TagCDATASection:
           switch( c )
           {
             case ']':
-              switch( forwardScan( i, data, "]]>" ) )
+              if( m_marker < 2 )
+                ++m_marker;
+              else
+                m_cdata += c;
+              break;
+            case '>':
+              if( m_marker == 2 )
               {
-                case ForwardFound:
-                  m_state = TagInside;
-                  break;
-                case ForwardNotFound:
-                  m_cdata += c;
-                  break;
-                case ForwardInsufficientSize:
-                  return -1;
+                m_marker = 0;
+                m_state = TagInside;
+                break;
               }
-              break;
+              // fall through
             default:
-              m_cdata += c;
+              m_cdata.append( m_marker, ']' );
+              m_marker = 0;
+              i = appendRun( m_cdata, data, i, length, CDATAStops, sizeof( CDATAStops ) );
               break;
           }
           break;
+        case TagEntity:               // we're collecting an entity, up to and including the ';'
+          m_entity += c;
+          if( c == ';' )
+          {
+            if( decode( m_entity ) == DecodeInvalid )
+            {
+              cleanup();
+              return static_cast<int>( i );
+            }
+            m_entity = EmptyString;
+            m_state = m_entityState;
+          }
+          else if( m_entity.length() > 9 )
+          {
+            cleanup();
+            return static_cast<int>( i );
+          }
+          break;
         case TagNameCollect:          // we're collecting the tag's name, we have at least one octet already
 //           printf( "TagNameCollect: %c\n", c );
           if( isWhitespace( c ) )
@@ -326,23 +397,16 @@ namespace gloox
           {
             case '<':
               addCData();
+              startView( i );
               m_state = TagOpening;
               break;
             case '&':
-//               printf( "TagInside, calling decode\n" );
-              switch( decode( i, data ) )
-              {
-                case DecodeValid:
-                  break;
-                case DecodeInvalid:
-                  cleanup();
-                  return static_cast<int>( i );
-                case DecodeInsufficient:
-                  return -1;
-              }
+              m_entity = c;
+              m_entityState = m_state;
+              m_state = TagEntity;
               break;
             default:
-              m_cdata += c;
+              i = appendRun( m_cdata, data, i, length, TextStops, sizeof( TextStops ) );
               break;
           }
           break;
@@ -463,6 +527,7 @@ namespace gloox
               break;
             default:
               m_attrib += c;
+              m_attribStart = rawOffset( i );
               m_state = TagAttribute;
               break;
           }
@@ -537,6 +602,7 @@ namespace gloox
             case '"':
               m_quote = true;
             case '\'':
+              m_valueStart = rawOffset( i ) + 1;
               m_state = TagAttributeValue;
               break;
             default:
@@ -565,21 +631,14 @@ namespace gloox
               m_quote = false;
               break;
             case '&':
-//               printf( "TagAttributeValue, calling decode\n" );
-              switch( decode( i, data ) )
-              {
-                case DecodeValid:
-                  break;
-                case DecodeInvalid:
-                  cleanup();
-                  return static_cast<int>( i );
-                case DecodeInsufficient:
-                  return -1;
-              }
+              m_entity = c;
+              m_entityState = m_state;
+              m_state = TagEntity;
               break;
             case '>':
             default:
-              m_value += c;
+              i = appendRun( m_value, data, i, length, ValueStops, sizeof( ValueStops ) );
+              break;
           }
           break;
         case TagNameAlmostComplete:
@@ -626,22 +685,45 @@ namespace gloox
 //       printf( "parser state: %d\n", m_state );
     }
 
+    if( m_rawActive )
+      m_view.m_xml.append( data + m_rawBase, length - m_rawBase );
+
     return -1;
   }
 
   void Parser::addTag()
   {
+    const bool view = m_viewHandler && !m_eventHandler && !m_root && !m_eventDepth
+                      && m_tag != "stream";
+    if( m_eventDepth || view || ( m_eventHandler && !m_root ) )
+    {
+      if( m_tag == "xml" && m_preamble == 2 )
+        cleanup();
+      else
+      {
+        m_viewing = m_viewing || view;
+        startEvent();
+        if( m_viewing )
+          addViewElement();
+      }
+      return;
+    }
+
+    m_rawActive = false;
+
+    TagArena* a = arena();
     if( !m_root )
     {
 //       printf( "created Tag named %s, ", m_tag.c_str() );
-      m_root = new Tag( m_tag );
+      m_root = new( a ) Tag( m_tag );
       m_current = m_root;
     }
     else
     {
 //       printf( "created Tag named %s, ", m_tag.c_str() );
-      m_current = new Tag( m_current, m_tag );
+      m_current = new( a ) Tag( m_current, m_tag );
     }
+    m_current->m_arena = a;
 
     if( m_haveTagPrefix )
     {
@@ -657,15 +739,15 @@ namespace gloox
       m_attribs.clear();
     }
 
-    if( m_xmlnss )
+    // the declarations are chained to the parent's, so the Tag needs only one pointer to see
+    // all the namespaces in scope
+    if( m_declarations )
     {
-//       printf( "have ns decls\n" );
-//       StringMap::const_iterator it = m_xmlnss->begin();
-//       for( ; it != m_xmlnss->end(); ++it )
-//         printf( "%s='%s'\n", (*it).first.c_str(), (*it).second.c_str() );
-      m_current->setXmlns( m_xmlnss );
-      m_xmlnss = 0;
+      m_current->m_scope = m_declarations;
+      m_declarations = 0;
     }
+    else if( m_current->m_parent )
+      m_current->m_scope = Tag::NamespaceScope::ref( m_current->m_parent->m_scope );
 
     m_current->setXmlns( m_xmlns );
     m_xmlns = EmptyString;
@@ -683,29 +765,217 @@ namespace gloox
       m_root->setXmlns( XMLNS_STREAM, m_tagPrefix );
 
     if( m_tag == "xml" && m_preamble == 2 )
+    {
       cleanup();
+      return;
+    }
+
+    if( m_current != m_root && !m_eventHandlers.empty() )
+    {
+      EventHandlerList::const_iterator it = m_eventHandlers.begin();
+      for( ; it != m_eventHandlers.end(); ++it )
+      {
+        if( (*it).tag == m_current->name()
+            && ( (*it).xmlns.empty() || (*it).xmlns == m_current->xmlns() ) )
+        {
+          startSubtreeEvent( (*it).handler );
+          break;
+        }
+      }
+    }
+  }
+
+  Parser::EventScope& Parser::pushEventScope()
+  {
+    if( m_eventDepth == m_eventScopes.size() )
+    {
+      EventScope scope;
+      scope.scope = 0;
+      m_eventScopes.push_back( scope );
+    }
+
+    return m_eventScopes[m_eventDepth++];
+  }
+
+  const std::string& Parser::eventXmlns( const std::string& prefix ) const
+  {
+    const Tag::NamespaceScope* s = m_eventDepth ? m_eventScopes[m_eventDepth-1].scope : 0;
+    for( ; s; s = s->parent )
+      if( s->prefix == prefix )
+        return s->xmlns;
+
+    return m_current ? m_current->xmlns( prefix ) : EmptyString;
+  }
+
+  Tag::NamespaceScope* Parser::namespaceScope() const
+  {
+    if( m_eventDepth )
+      return m_eventScopes[m_eventDepth-1].scope;
+
+    return m_current ? m_current->m_scope : 0;
+  }
+
+  void Parser::startEvent()
+  {
+    if( !m_eventDepth && !m_root )
+      m_activeHandler = m_eventHandler;
+
+    EventScope& scope = pushEventScope();
+    scope.name = m_tag;
+    scope.prefix = m_haveTagPrefix ? m_tagPrefix : EmptyString;
+    if( !m_xmlns.empty() )
+      scope.defaultXmlns = m_xmlns;
+    else if( m_eventDepth > 1 )
+      scope.defaultXmlns = m_eventScopes[m_eventDepth-2].defaultXmlns;
+    else
+      scope.defaultXmlns = EmptyString;
+    scope.scope = m_declarations ? m_declarations
+                                 : Tag::NamespaceScope::ref( m_eventDepth > 1
+                                                             ? m_eventScopes[m_eventDepth-2].scope
+                                                             : 0 );
+    m_declarations = 0;
+    m_xmlns = EmptyString;
+    m_haveTagPrefix = false;
+
+    if( scope.prefix.empty() )
+      scope.xmlns = scope.defaultXmlns;
+    else
+      scope.xmlns = eventXmlns( scope.prefix );
+
+    if( m_activeHandler )
+    {
+      m_activeHandler->handleStartElement( scope.name, scope.prefix, scope.xmlns );
+      Tag::AttributeList::const_iterator it = m_attribs.begin();
+      for( ; it != m_attribs.end(); ++it )
+        m_activeHandler->handleAttribute( (*it)->name(), (*it)->prefix(), (*it)->value() );
+    }
+
+    util::clearList( m_attribs );
+  }
+
+  void Parser::startSubtreeEvent( TagEventHandler* teh )
+  {
+    m_activeHandler = teh;
+
+    EventScope& scope = pushEventScope();
+    scope.name = m_current->name();
+    scope.prefix = m_current->prefix();
+    scope.xmlns = m_current->xmlns();
+    scope.defaultXmlns = m_current->xmlns( EmptyString );
+    scope.scope = Tag::NamespaceScope::ref( m_current->m_scope );
+
+    m_activeHandler->handleStartElement( scope.name, scope.prefix, scope.xmlns );
+    Tag::AttributeList::const_iterator it = m_current->attributes().begin();
+    for( ; it != m_current->attributes().end(); ++it )
+      m_activeHandler->handleAttribute( (*it)->name(), (*it)->prefix(), (*it)->value() );
+  }
+
+  bool Parser::endEvent()
+  {
+    EventScope& scope = m_eventScopes[m_eventDepth-1];
+    if( scope.name != m_tag || ( !scope.prefix.empty() && scope.prefix != m_tagPrefix ) )
+      return false;
+
+    if( m_activeHandler )
+      m_activeHandler->handleEndElement( scope.name, scope.prefix );
+
+    Tag::NamespaceScope::release( scope.scope );
+    scope.scope = 0;
+    if( !--m_eventDepth )
+      m_activeHandler = 0;
+
+    return true;
+  }
+
+  void Parser::startView( std::string::size_type pos )
+  {
+    if( m_viewHandler && !m_root && !m_eventDepth )
+    {
+      m_view.clear();
+      m_rawBase = pos;
+      m_rawActive = true;
+    }
+
+    m_tagStart = rawOffset( pos );
+  }
+
+  void Parser::addViewElement()
+  {
+    const EventScope& scope = m_eventScopes[m_eventDepth-1];
+    if( m_eventDepth == 1 )
+    {
+      m_view.m_name = scope.name;
+      m_view.m_xmlns = scope.xmlns;
+    }
+    else if( m_eventDepth == 2 )
+    {
+      StanzaView::Element e;
+      e.name = scope.name;
+      e.xmlns = scope.xmlns;
+      e.begin = m_tagStart;
+      e.end = m_tagStart;
+      m_view.m_children.push_back( e );
+    }
+  }
+
+  void Parser::endViewElement()
+  {
+    if( m_eventDepth == 1 )
+      m_view.m_children.back().end = rawOffset( m_pos ) + 1;
+    else if( !m_eventDepth )
+    {
+      m_view.m_xml.append( m_chunk + m_rawBase, m_pos + 1 - m_rawBase );
+      m_rawActive = false;
+      m_viewing = false;
+      if( m_viewHandler )
+        m_viewHandler->handleStanzaView( m_view );
+    }
   }
 
   void Parser::addAttribute()
   {
-    Tag::Attribute* attr = new Tag::Attribute( m_attrib, m_value );;
+    // attributes of viewed elements are not kept, only those of the top-level element are
+    // recorded as offsets into the raw bytes
+    const bool view = m_viewHandler && !m_eventHandler && !m_root
+                      && ( m_eventDepth ? m_viewing : m_tag != "stream" );
+
+    Tag::Attribute* attr = view ? 0 : new( arena() ) Tag::Attribute( m_attrib, m_value );
     if( m_attribIsXmlns )
     {
-      if( !m_xmlnss )
-        m_xmlnss = new StringMap();
+      if( !m_declarations )
+        m_declarations = Tag::NamespaceScope::ref( namespaceScope() );
 
-      (*m_xmlnss)[m_attrib] = m_value;
-      attr->setPrefix( XMLNS );
+      m_declarations = Tag::NamespaceScope::push( m_declarations, m_attrib, m_value );
+      if( attr )
+        attr->setPrefix( XMLNS );
     }
     else
     {
 //   printf( "adding attribute: %s:%s='%s'\n", m_attribPrefix.c_str(), m_attrib.c_str(), m_value.c_str() );
-      if( !m_attribPrefix.empty() )
+      if( attr && !m_attribPrefix.empty() )
         attr->setPrefix( m_attribPrefix );
       if( m_attrib == XMLNS )
         m_xmlns = m_value;
     }
-    m_attribs.push_back( attr );
+
+    if( attr )
+      m_attribs.push_back( attr );
+    else if( !m_eventDepth )
+    {
+      StanzaView::Attribute a;
+      a.nameBegin = m_attribStart;
+      a.nameLength = m_attrib.length();
+      if( m_attribIsXmlns )
+        a.nameLength += XMLNS.length() + 1;
+      else if( m_haveAttribPrefix )
+        a.nameLength += m_attribPrefix.length() + 1;
+      a.valueBegin = m_valueStart;
+      a.valueLength = rawOffset( m_pos ) - m_valueStart;
+      a.escaped = a.valueLength != m_value.length();
+      if( a.escaped )
+        a.value = m_value;
+      m_view.m_attributes.push_back( a );
+    }
     m_attrib = EmptyString;
     m_value = EmptyString;
     m_attribPrefix = EmptyString;
@@ -715,7 +985,13 @@ namespace gloox
 
   void Parser::addCData()
   {
-    if( m_current && !m_cdata.empty() )
+    if( m_eventDepth && !m_cdata.empty() )
+    {
+      if( m_activeHandler )
+        m_activeHandler->handleText( m_cdata );
+      m_cdata = EmptyString;
+    }
+    else if( m_current && !m_cdata.empty() )
     {
       m_current->addCData( m_cdata );
 //       printf( "added cdata %s to %s: %s\n",
@@ -728,8 +1004,28 @@ namespace gloox
   {
 //     printf( "about to close, " );
 
+    if( m_eventDepth )
+    {
+      if( !endEvent() )
+        return false;
+
+      if( m_viewing )
+        endViewElement();
+
+      // the root of a subtree reported as events is closed in the Tag tree, too
+      if( m_eventDepth || !m_current )
+      {
+        m_tagPrefix = EmptyString;
+        m_haveTagPrefix = false;
+        return true;
+      }
+    }
+
     if( m_tag == "stream" && m_tagPrefix == "stream" )
+    {
+      m_rawActive = false;
       return true;
+    }
 
     if( !m_current || m_current->name() != m_tag
         || ( !m_current->prefix().empty() && m_current->prefix() != m_tagPrefix ) )
@@ -764,8 +1060,8 @@ namespace gloox
       delete m_root;
     m_root = 0;
     m_current = 0;
-    delete m_xmlnss;
-    m_xmlnss = 0;
+    Tag::NamespaceScope::release( m_declarations );
+    m_declarations = 0;
     m_cdata = EmptyString;
     m_tag = EmptyString;
     m_attrib = EmptyString;
@@ -777,6 +1073,20 @@ namespace gloox
     m_xmlns = EmptyString;
     util::clearList( m_attribs );
     m_attribs.clear();
+    for( ; m_eventDepth; --m_eventDepth )
+    {
+      Tag::NamespaceScope::release( m_eventScopes[m_eventDepth-1].scope );
+      m_eventScopes[m_eventDepth-1].scope = 0;
+    }
+    m_activeHandler = 0;
+    m_view.clear();
+    m_rawActive = false;
+    m_viewing = false;
+    if( m_stanzaArena && deleteRoot )
+      m_stanzaArena->reset();
+    m_stanzaArena = 0;
+    m_entity = EmptyString;
+    m_marker = 0;
     m_state = Initial;
     m_preamble = 0;
   }
@@ -17,13 +17,18 @@
 
 #include "gloox.h"
 #include "taghandler.h"
+#include "tageventhandler.h"
+#include "stanzaviewhandler.h"
 #include "tag.h"
 
+#include <list>
 #include <string>
+#include <vector>
 
 namespace gloox
 {
 
+  class TagArena;
 
   /**
    * @brief This class implements an XML parser.
@@ -49,11 +54,79 @@ namespace gloox
 
       /**
        * Use this function to feed the parser with more XML.
-       * @param data Raw xml to parse. It may be modified if backbuffering is necessary.
+       * @param data Raw xml to parse.
        * @return Returns @b -1 if parsing was successful. If a parse error occured, the
        * character position where the error was occured is returned.
        */
-      int feed( std::string& data );
+      int feed( const std::string& data );
+
+      /**
+       * Use this function to feed the parser with more XML. The buffer is tokenized in place
+       * and is neither copied nor modified. Partial entities and CDATA markers at the end
+       * of the buffer are kept as parser state and resumed with the next call.
+       * @param data Pointer to the raw xml to parse.
+       * @param length The number of bytes available at @c data.
+       * @return Returns @b -1 if parsing was successful. If a parse error occured, the
+       * character position (relative to @c data) where the error was occured is returned.
+       * @since 1.0
+       */
+      int feed( const char* data, std::string::size_type length );
+
+      /**
+       * Switches usage of a TagArena on/off. Default: off. If enabled, all Tags, attributes and
+       * internal nodes of a top-level element are allocated from an arena owned by the Parser,
+       * which is reset in one step once the TagHandler returns. Handlers must not keep pointers
+       * to such Tags; use Tag::clone() to keep a copy. The setting takes effect with the next
+       * top-level element and is ignored if parsed Tags are not deleted after pushing them
+       * upstream (see the constructor's @c deleteRoot).
+       * @param arena Whether to switch arena usage on or off.
+       * @since 1.0
+       */
+      void setArena( bool arena );
+
+      /**
+       * Sets a TagEventHandler that receives all parsed XML as events. While such a handler
+       * is set, the Parser does not build any Tags and the TagHandler passed to the
+       * constructor is not called. The setting takes effect with the next top-level element.
+       * @param teh The TagEventHandler to use, or 0 to go back to building Tags.
+       * @since 1.0
+       */
+      void setEventHandler( TagEventHandler* teh ) { m_eventHandler = teh; }
+
+      /**
+       * Sets a StanzaViewHandler that receives all top-level elements (except the stream
+       * header) as StanzaViews. While such a handler is set, the Parser does not build Tags
+       * for these elements but only records the element's raw bytes, attributes, and the
+       * names, namespaces and positions of its direct children. The TagHandler passed to the
+       * constructor still receives the stream header. A TagEventHandler set using
+       * setEventHandler() takes precedence. The setting takes effect with the next top-level
+       * element.
+       * @param svh The StanzaViewHandler to use, or 0 to go back to building Tags.
+       * @since 1.0
+       */
+      void setStanzaViewHandler( StanzaViewHandler* svh ) { m_viewHandler = svh; }
+
+      /**
+       * Registers a TagEventHandler for the subtrees rooted at elements with the given name and
+       * namespace below a top-level element. Such an element is reported to the handler
+       * as events, including its attributes and all its contents. The element itself (with its
+       * attributes) is still added to the Tag tree passed to the TagHandler, but without any
+       * children or character data.
+       * @param teh The TagEventHandler to register.
+       * @param tag The element's name.
+       * @param xmlns The element's namespace. If empty, elements with any namespace match.
+       * @since 1.0
+       */
+      void registerEventHandler( TagEventHandler* teh, const std::string& tag,
+                                 const std::string& xmlns = EmptyString );
+
+      /**
+       * Removes all registrations of the given TagEventHandler. If the handler is currently
+       * receiving a subtree, the rest of the subtree is silently skipped.
+       * @param teh The TagEventHandler to remove.
+       * @since 1.0
+       */
+      void removeEventHandler( TagEventHandler* teh );
 
       /**
        * Resets internal state.
@@ -82,22 +155,35 @@ namespace gloox
         TagValueApos,
         TagAttributeValue,
         TagPreamble,
-        TagCDATASection
+        TagCDATAOpening,
+        TagCDATASection,
+        TagEntity
       };
 
-      enum ForwardScanState
+      enum DecodeState
       {
-        ForwardFound,
-        ForwardNotFound,
-        ForwardInsufficientSize
+        DecodeValid,
+        DecodeInvalid
       };
 
-      enum DecodeState
+      struct EventHandlerEntry
       {
-        DecodeValid,
-        DecodeInvalid,
-        DecodeInsufficient
+        TagEventHandler* handler;
+        std::string tag;
+        std::string xmlns;
+      };
+      typedef std::list<EventHandlerEntry> EventHandlerList;
+
+      // an element currently reported as events; the slots are re-used
+      struct EventScope
+      {
+        std::string name;
+        std::string prefix;
+        std::string xmlns;
+        std::string defaultXmlns;
+        Tag::NamespaceScope* scope;     // the namespace declarations in scope
       };
+      typedef std::vector<EventScope> EventScopeList;
 
       void addTag();
       void addAttribute();
@@ -106,16 +192,44 @@ namespace gloox
       bool isWhitespace( unsigned char c );
       bool isValid( unsigned char c );
       void streamEvent( Tag* tag );
-      ForwardScanState forwardScan( std::string::size_type& pos, const std::string& data,
-                                    const std::string& needle );
-      DecodeState decode( std::string::size_type& pos, const std::string& data );
+      void startEvent();
+      void startSubtreeEvent( TagEventHandler* teh );
+      bool endEvent();
+      void startView( std::string::size_type pos );
+      void addViewElement();
+      void endViewElement();
+      std::string::size_type rawOffset( std::string::size_type pos ) const
+        { return m_view.m_xml.length() + pos - m_rawBase; }
+      EventScope& pushEventScope();
+      const std::string& eventXmlns( const std::string& prefix ) const;
+      Tag::NamespaceScope* namespaceScope() const;
+      TagArena* arena();
+      DecodeState decode( const std::string& entity );
 
       TagHandler* m_tagHandler;
+      TagArena* m_arena;
+      TagArena* m_stanzaArena;
       Tag* m_current;
       Tag* m_root;
-      StringMap* m_xmlnss;
+      Tag::NamespaceScope* m_declarations; // declared by the element being parsed, if any
+      TagEventHandler* m_eventHandler;
+      TagEventHandler* m_activeHandler;
+      EventHandlerList m_eventHandlers;
+      EventScopeList m_eventScopes;
+      EventScopeList::size_type m_eventDepth;
+      StanzaViewHandler* m_viewHandler;
+      StanzaView m_view;
+      const char* m_chunk;                  // the buffer currently fed
+      std::string::size_type m_pos;         // the current position in m_chunk
+      std::string::size_type m_rawBase;     // the position in m_chunk m_view's raw bytes continue at
+      std::string::size_type m_tagStart;    // raw offset of the current element's '<'
+      std::string::size_type m_attribStart; // raw offset of the current attribute's name
+      std::string::size_type m_valueStart;  // raw offset of the current attribute's value
+      bool m_rawActive;                     // whether the bytes fed are recorded in m_view
+      bool m_viewing;                       // whether the current top-level element is viewed
 
       ParserInternalState m_state;
+      ParserInternalState m_entityState;
       Tag::AttributeList m_attribs;
       std::string m_tag;
       std::string m_cdata;
@@ -124,13 +238,15 @@ namespace gloox
       std::string m_xmlns;
       std::string m_tagPrefix;
       std::string m_attribPrefix;
-      std::string m_backBuffer;
+      std::string m_entity;
+      int m_marker;
       int m_preamble;
       bool m_quote;
       bool m_haveTagPrefix;
       bool m_haveAttribPrefix;
       bool m_attribIsXmlns;
       bool m_deleteRoot;
+      bool m_useArena;
 
   };
 
@@ -25,6 +25,8 @@ namespace gloox
     "available", "", "", "", "", "unavailable", "probe", "error"
   };
 
+  static const util::LookupTable msgTypeTable( msgTypeStringValues );
+
   static inline const std::string typeString( Presence::PresenceType type )
   {
     return util::lookup( type, msgTypeStringValues );
@@ -35,30 +37,43 @@ namespace gloox
     "", "chat", "away", "dnd", "xa", "", "", ""
   };
 
+  static const util::LookupTable msgShowTable( msgShowStringValues );
+
   static inline const std::string showString( Presence::PresenceType type )
   {
     return util::lookup( type, msgShowStringValues );
   }
 
-  Presence::Presence( Tag* tag )
-    : Stanza( tag ), m_subtype( Invalid ), m_stati( 0 ), m_priority( 0 )
+  Presence::Presence( Tag* tag, bool lazy )
+    : Stanza( tag, lazy ), m_subtype( Invalid ), m_stati( 0 ), m_priority( 0 )
   {
     if( !tag || tag->name() != "presence" )
+    {
+      m_pending &= ~PendingPayload;
       return;
+    }
 
     const std::string& type = tag->findAttribute( TYPE );
     if( type.empty() )
       m_subtype = Available;
     else
-      m_subtype = (PresenceType)util::lookup( type, msgTypeStringValues );
+      m_subtype = (PresenceType)msgTypeTable.find( type );
 
     if( m_subtype == Available )
     {
       Tag* t = tag->findChild( "show" );
       if( t )
-        m_subtype = (PresenceType)util::lookup( t->cdata(), msgShowStringValues );
+        m_subtype = (PresenceType)msgShowTable.find( t->cdata() );
     }
 
+    if( !lazy )
+      parsePayload( tag );
+  }
+
+  void Presence::parsePayload( const Tag* tag )
+  {
+    m_pending &= ~PendingPayload;
+
     const TagList& c = tag->children();
     TagList::const_iterator it = c.begin();
     for( ; it != c.end(); ++it )
@@ -86,6 +101,7 @@ namespace gloox
 
   void Presence::resetStatus()
   {
+    decode();
     delete m_stati;
     m_stati = 0;
     m_status = "";
@@ -93,6 +109,7 @@ namespace gloox
 
   void Presence::setPriority( int priority )
   {
+    decode();
     if( priority < -128 )
       m_priority = -128;
     else if( priority > 127 )
@@ -111,10 +128,12 @@ namespace gloox
     if( m_subtype == Invalid )
       return 0;
 
+    decode();
+
     Tag* t = new Tag( "presence" );
-    if( m_to )
+    if( to() )
       t->addAttribute( "to", m_to.full() );
-    if( m_from )
+    if( from() )
       t->addAttribute( "from", m_from.full() );
 
     const std::string& type = typeString( m_subtype );
@@ -134,11 +153,44 @@ namespace gloox
 
     getLangs( m_stati, m_status, "status", t );
 
-    StanzaExtensionList::const_iterator it = m_extensionList.begin();
+    StanzaExtensionList::const_iterator it = extensions().begin();
     for( ; it != m_extensionList.end(); ++it )
       t->addChild( (*it)->tag() );
 
     return t;
   }
 
+  bool Presence::appendXml( std::string& out, const std::string& from,
+                            const std::string& xmlns ) const
+  {
+    if( m_subtype == Invalid )
+      return false;
+
+    decode();
+
+    out += "<presence";
+    appendAddresses( out );
+
+    const std::string& type = typeString( m_subtype );
+    if( type != "available" )
+      appendAttribute( out, "type", type );
+
+    appendStartTagEnd( out, from, xmlns );
+    const std::string::size_type contents = out.length();
+
+    if( type.empty() )
+    {
+      const std::string& show = showString( m_subtype );
+      if( !show.empty() )
+        appendElement( out, "show", show );
+    }
+
+    appendElement( out, "priority", util::int2string( m_priority ) );
+    appendLangs( m_stati, m_status, "status", out );
+
+    appendExtensions( out );
+    appendEndTag( out, contents, "presence" );
+    return true;
+  }
+
 }
@@ -105,6 +105,7 @@ namespace gloox
        */
       const std::string status( const std::string& lang = "default" ) const
       {
+        decode();
         return findLang( m_stati, m_status, lang );
       }
 
@@ -116,6 +117,7 @@ namespace gloox
        */
       void addStatus( const std::string& status, const std::string& lang = EmptyString )
       {
+        decode();
         setLang( &m_stati, m_status, status, lang );
       }
 
@@ -128,7 +130,7 @@ namespace gloox
        * Returns the presence priority in the legal range: -128 to +127.
        * @return The priority information contained in the stanza, defaults to 0.
        */
-      int priority() const { return m_priority; }
+      int priority() const { decode(); return m_priority; }
 
       /**
        * Sets the priority. Legal range: -128 to +127.
@@ -139,6 +141,10 @@ namespace gloox
       // reimplemented from Stanza
       virtual Tag* tag() const;
 
+      // reimplemented from Stanza
+      virtual bool appendXml( std::string& out, const std::string& from = EmptyString,
+                              const std::string& xmlns = EmptyString ) const;
+
     private:
 #ifdef PRESENCE_TEST
     public:
@@ -147,7 +153,11 @@ namespace gloox
        * Creates a Presence request from the given Tag. The original Tag will be ripped off.
        * @param tag The Tag to parse.
        */
-      Presence( Tag* tag );
+      Presence( Tag* tag, bool lazy = false );
+
+      void decode() const
+        { if( m_pending & PendingPayload ) const_cast<Presence*>( this )->parsePayload( m_source ); }
+      void parsePayload( const Tag* tag );
 
       PresenceType m_subtype;
       StringMap* m_stati;
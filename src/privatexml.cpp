@@ -28,10 +28,14 @@ namespace gloox
     if( tag->name() == "query" && tag->xmlns() == XMLNS_PRIVATE_XML )
     {
       if( tag->children().size() )
-        m_privateXML = tag->children().front()->clone();
+        m_privateXML = tag->children().front()->cloneShared();
     }
     else
-      m_privateXML = tag;
+    {
+      // copies of the Query and the Tags created by tag() share the payload
+      m_privateXML = tag->cloneShared();
+      delete tag;
+    }
   }
 
   const std::string& PrivateXML::Query::filterString() const
@@ -45,7 +49,7 @@ namespace gloox
     Tag* t = new Tag( "query" );
     t->setXmlns( XMLNS_PRIVATE_XML );
     if( m_privateXML )
-      t->addChild( m_privateXML->clone() );
+      t->addChild( m_privateXML->share() );
     return t;
   }
   // ---- ~PrivateXML::Query ----
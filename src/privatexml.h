@@ -98,7 +98,9 @@ namespace gloox
           Query( const std::string& tag, const std::string& xmlns )
             : StanzaExtension( ExtPrivateXML )
           {
-            m_privateXML = new Tag( tag, XMLNS, xmlns );
+            Tag* t = new Tag( tag, XMLNS, xmlns );
+            m_privateXML = t->cloneShared();
+            delete t;
           }
 
           /**
@@ -135,7 +137,7 @@ namespace gloox
           virtual StanzaExtension* clone() const
           {
             Query* q = new Query();
-            q->m_privateXML = m_privateXML ? m_privateXML->clone() : 0;
+            q->m_privateXML = m_privateXML ? m_privateXML->share() : 0;
             return q;
           }
 
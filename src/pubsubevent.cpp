@@ -32,7 +32,7 @@ namespace gloox
 
     Event::ItemOperation::ItemOperation( const ItemOperation& right )
       : retract( right.retract ), item( right.item ),
-        payload( right.payload ? right.payload->clone() : 0 )
+        payload( right.payload ? right.payload->share() : 0 )
     {
     }
 
@@ -59,7 +59,7 @@ namespace gloox
             {
               m_node = tag->findAttribute( "id" );
               if( ( m_config = tag->findChild( "x" ) ) )
-                m_config = m_config->clone();
+                m_config = m_config->cloneShared();
             }
             break;
 
@@ -69,7 +69,7 @@ namespace gloox
             m_node = tag->findAttribute( "node" );
             if( type == PubSub::EventConfigure
                 && ( m_config = tag->findChild( "x" ) ) )
-              m_config = m_config->clone();
+              m_config = m_config->cloneShared();
             break;
 
           case PubSub::EventItems:
@@ -92,7 +92,7 @@ namespace gloox
               }
               ItemOperation* op = new ItemOperation( retract,
                                                      tag->findAttribute( "id" ),
-                                                     tag->clone() );
+                                                     tag->cloneShared() );
               m_itemOperations->push_back( op );
             }
             break;
@@ -258,7 +258,7 @@ namespace gloox
     {
       Event* e = new Event( m_node, m_type );
       e->m_subscriptionIDs = m_subscriptionIDs ? new StringList( *m_subscriptionIDs ) : 0;
-      e->m_config = m_config ? m_config->clone() : 0;
+      e->m_config = m_config ? m_config->share() : 0;
       if( m_itemOperations )
       {
         e->m_itemOperations = new ItemOperationList();
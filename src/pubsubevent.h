@@ -46,7 +46,8 @@ namespace gloox
            * @param remove Whether this is a retract operation or not (ie item).
            * @param itemid Item ID of this item.
            * @param pld Payload for this object (in the case of a non transient
-           * item notification).
+           * item notification). Copies of the ItemOperation share it (see Tag::share()). Pass
+           * a Tag created by Tag::cloneShared() if copies are made from different threads.
            */
           ItemOperation( bool remove, const std::string& itemid, const Tag* pld = 0 )
             : retract( remove ), item( itemid ), payload( pld )
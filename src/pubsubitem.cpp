@@ -33,12 +33,13 @@ namespace gloox
 
       m_id = tag->findAttribute( "id" );
 
+      // copies of the Item and the Tags created by tag() share the payload
       if( tag->children().size() )
-        m_payload = tag->children().front()->clone();
+        m_payload = tag->children().front()->cloneShared();
     }
 
     Item::Item( const Item& item )
-      : m_payload( item.m_payload ? item.m_payload->clone() : 0 )
+      : m_payload( item.m_payload ? item.m_payload->share() : 0 )
     {
       m_id = item.m_id;
     }
@@ -53,7 +54,7 @@ namespace gloox
       Tag* t = new Tag( "item" );
       t->addAttribute( "id", m_id );
       if( m_payload )
-        t->addChild( m_payload->clone() );
+        t->addChild( m_payload->share() );
 
       return t;
     }
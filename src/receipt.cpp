@@ -50,4 +50,15 @@ namespace gloox
     return new Tag( util::lookup( m_rcpt, receiptValues ), XMLNS, XMLNS_RECEIPTS );
   }
 
+  void Receipt::appendXml( std::string& out ) const
+  {
+    if( m_rcpt == Invalid )
+      return;
+
+    out += '<';
+    out += util::lookup( m_rcpt, receiptValues );
+    util::appendAttribute( out, "xmlns", XMLNS_RECEIPTS );
+    out += "/>";
+  }
+
 }
@@ -79,6 +79,9 @@ namespace gloox
       // reimplemented from StanzaExtension
       Tag* tag() const;
 
+      // reimplemented from StanzaExtension
+      void appendXml( std::string& out ) const;
+
       // reimplemented from StanzaExtension
       virtual StanzaExtension* clone() const
       {
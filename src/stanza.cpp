@@ -19,24 +19,36 @@
 #include "stanzaextensionfactory.h"
 
 #include <cstdlib>
+#include <cstring>
 
 namespace gloox
 {
 
   Stanza::Stanza( const JID& to )
-    : m_xmllang( "default" ), m_to( to )
+    : m_xmllang( "default" ), m_to( to ), m_source( 0 ), m_pending( 0 ), m_seFactory( 0 )
   {
+    std::memset( m_extensionSlots, 0, sizeof( m_extensionSlots ) );
   }
 
-  Stanza::Stanza( Tag* tag )
-    : m_xmllang( "default" )
+  Stanza::Stanza( Tag* tag, bool lazy )
+    : m_xmllang( "default" ), m_source( 0 ), m_pending( 0 ), m_seFactory( 0 )
   {
+    std::memset( m_extensionSlots, 0, sizeof( m_extensionSlots ) );
+
     if( !tag )
       return;
 
+    m_id = tag->findAttribute( "id" );
+
+    if( lazy )
+    {
+      m_source = tag;
+      m_pending = PendingFrom | PendingTo | PendingPayload;
+      return;
+    }
+
     m_from.setJID( tag->findAttribute( "from" ) );
     m_to.setJID( tag->findAttribute( "to" ) );
-    m_id = tag->findAttribute( "id" );
   }
 
   Stanza::~Stanza()
@@ -49,13 +61,53 @@ namespace gloox
     return findExtension<Error>( ExtError );
   }
 
+  void Stanza::decodeFrom() const
+  {
+    m_pending &= ~PendingFrom;
+    m_from.setJID( m_source->findAttribute( "from" ) );
+  }
+
+  void Stanza::decodeTo() const
+  {
+    m_pending &= ~PendingTo;
+    m_to.setJID( m_source->findAttribute( "to" ) );
+  }
+
+  void Stanza::deferExtensions( StanzaExtensionFactory* factory )
+  {
+    if( !factory || !m_source )
+      return;
+
+    m_seFactory = factory;
+    m_pending |= PendingExtensions;
+  }
+
+  void Stanza::decodeExtensions() const
+  {
+    m_pending &= ~PendingExtensions;
+    m_seFactory->addExtensions( *const_cast<Stanza*>( this ), m_source );
+  }
+
   void Stanza::addExtension( const StanzaExtension* se )
   {
+    if( m_pending & PendingExtensions )
+      decodeExtensions();
+
     m_extensionList.push_back( se );
+
+    const int type = se->extensionType();
+    if( type >= 0 && type < ExtUser && !m_extensionSlots[type] )
+      m_extensionSlots[type] = se;
   }
 
   const StanzaExtension* Stanza::findExtension( int type ) const
   {
+    if( m_pending & PendingExtensions )
+      decodeExtensions();
+
+    if( type >= 0 && type < ExtUser )
+      return m_extensionSlots[type];
+
     StanzaExtensionList::const_iterator it = m_extensionList.begin();
     for( ; it != m_extensionList.end() && (*it)->extensionType() != type; ++it ) ;
     return it != m_extensionList.end() ? (*it) : 0;
@@ -63,7 +115,9 @@ namespace gloox
 
   void Stanza::removeExtensions()
   {
+    m_pending &= ~PendingExtensions;
     util::clearList( m_extensionList );
+    std::memset( m_extensionSlots, 0, sizeof( m_extensionSlots ) );
   }
 
   void Stanza::setLang( StringMap** map,
@@ -124,4 +178,98 @@ namespace gloox
     }
   }
 
+  bool Stanza::appendXml( std::string& out, const std::string& from,
+                          const std::string& xmlns ) const
+  {
+    Tag* t = tag();
+    if( !t )
+      return false;
+
+    if( !from.empty() && !t->hasAttribute( "from" ) )
+      t->addAttribute( "from", from );
+    if( !xmlns.empty() && t->xmlns().empty() )
+      t->setXmlns( xmlns );
+
+    t->appendXml( out );
+    delete t;
+    return true;
+  }
+
+  void Stanza::appendAddresses( std::string& out ) const
+  {
+    if( to() )
+      appendAttribute( out, "to", m_to.full() );
+    if( from() )
+      appendAttribute( out, "from", m_from.full() );
+  }
+
+  void Stanza::appendStartTagEnd( std::string& out, const std::string& from,
+                                  const std::string& xmlns ) const
+  {
+    if( !this->from() )
+      appendAttribute( out, "from", from );
+    appendAttribute( out, "xmlns", xmlns );
+    out += '>';
+  }
+
+  void Stanza::appendExtensions( std::string& out ) const
+  {
+    StanzaExtensionList::const_iterator it = extensions().begin();
+    for( ; it != m_extensionList.end(); ++it )
+      (*it)->appendXml( out );
+  }
+
+  void Stanza::appendEndTag( std::string& out, std::string::size_type contents, const char* name )
+  {
+    if( out.length() == contents )
+    {
+      out.insert( contents - 1, 1, '/' );
+      return;
+    }
+
+    out += "</";
+    out += name;
+    out += '>';
+  }
+
+  void Stanza::appendAttribute( std::string& out, const char* name, const std::string& value )
+  {
+    util::appendAttribute( out, name, value );
+  }
+
+  void Stanza::appendElement( std::string& out, const char* name, const std::string& cdata,
+                              const std::string& xmllang )
+  {
+    out += '<';
+    out += name;
+    appendAttribute( out, "xml:lang", xmllang );
+
+    if( cdata.empty() || !util::checkValidXMLChars( cdata ) )
+    {
+      out += "/>";
+      return;
+    }
+
+    out += '>';
+    util::appendEscaped( out, cdata );
+    out += "</";
+    out += name;
+    out += '>';
+  }
+
+  void Stanza::appendLangs( const StringMap* map,
+                            const std::string& defaultData,
+                            const char* name, std::string& out )
+  {
+    if( !defaultData.empty() )
+      appendElement( out, name, defaultData );
+
+    if( !map )
+      return;
+
+    StringMap::const_iterator it = map->begin();
+    for( ; it != map->end(); ++it )
+      appendElement( out, name, (*it).second, (*it).first );
+  }
+
 }
@@ -23,6 +23,7 @@ namespace gloox
 {
 
   class Error;
+  class StanzaExtensionFactory;
 
   /**
    * @brief This is the base class for XMPP stanza abstractions.
@@ -32,6 +33,9 @@ namespace gloox
    */
   class GLOOX_API Stanza
   {
+
+    friend class ClientBase;
+
     public:
       /**
        * Virtual destructor.
@@ -42,19 +46,19 @@ namespace gloox
        * Sets the 'from' address of the Stanza. This useful for @link gloox::Component Components @endlink.
        * @param from The from address.
        */
-      void setFrom( const JID& from ) { m_from = from; }
+      void setFrom( const JID& from ) { m_pending &= ~PendingFrom; m_from = from; }
 
       /**
        * Returns the JID the stanza comes from.
        * @return The origin of the stanza.
        */
-      const JID& from() const { return m_from; }
+      const JID& from() const { if( m_pending & PendingFrom ) decodeFrom(); return m_from; }
 
       /**
        * Returns the receiver of the stanza.
        * @return The stanza's destination.
        */
-      const JID& to() const { return m_to; }
+      const JID& to() const { if( m_pending & PendingTo ) decodeTo(); return m_to; }
 
       /**
        * Returns the id of the stanza, if set.
@@ -85,7 +89,8 @@ namespace gloox
       void addExtension( const StanzaExtension* se );
 
       /**
-       * Finds a StanzaExtension of a particular type.
+       * Finds a StanzaExtension of a particular type. If there are several, the first one
+       * added is returned. For built-in types (below ExtUser) this takes constant time.
        * @param type StanzaExtensionType to search for.
        * @return A pointer to the StanzaExtension, or 0 if none was found.
        */
@@ -110,7 +115,8 @@ namespace gloox
        * Returns the list of the Stanza's extensions.
        * @return The list of the Stanza's extensions.
        */
-      const StanzaExtensionList& extensions() const { return m_extensionList; }
+      const StanzaExtensionList& extensions() const
+        { if( m_pending & PendingExtensions ) decodeExtensions(); return m_extensionList; }
 
       /**
        * Removes (deletes) all the stanza's extensions.
@@ -126,13 +132,39 @@ namespace gloox
        */
       virtual Tag* tag() const = 0;
 
+      /**
+       * Appends the Stanza's XML representation to the given string. Unlike serializing the
+       * result of tag(), this writes the Stanza's contents to @c out directly, without copying
+       * them into a temporary Tag tree first.
+       * @param out The string to append to.
+       * @param from A 'from' address to add if the Stanza doesn't have one. May be empty.
+       * @param xmlns A namespace to put on the stanza element. May be empty.
+       * @return @b False if the Stanza is invalid (nothing has been appended), @b true otherwise.
+       * @since 1.0
+       */
+      virtual bool appendXml( std::string& out, const std::string& from = EmptyString,
+                              const std::string& xmlns = EmptyString ) const;
+
     protected:
+      /**
+       * Parts of a lazily decoded Stanza that have not been decoded yet.
+       */
+      enum PendingPart
+      {
+        PendingFrom       =  1,     /**< The 'from' address. */
+        PendingTo         =  2,     /**< The 'to' address. */
+        PendingPayload    =  4,     /**< Type-specific child elements, e.g. a message's body. */
+        PendingExtensions =  8      /**< The StanzaExtensions. */
+      };
+
       /**
        * Creates a new Stanza, taking from and to addresses from the given Tag.
        * @param tag The Tag to create the Stanza from.
+       * @param lazy Whether to decode the addresses (and the derived class' payload) only on
+       * first access. If @b true, the Tag must outlive the Stanza.
        * @since 1.0
        */
-      Stanza( Tag* tag );
+      Stanza( Tag* tag, bool lazy = false );
 
       /**
        * Creates a new Stanza object and initializes the receiver's JID.
@@ -144,8 +176,10 @@ namespace gloox
       StanzaExtensionList m_extensionList;
       std::string m_id;
       std::string m_xmllang;
-      JID m_from;
-      JID m_to;
+      mutable JID m_from;
+      mutable JID m_to;
+      Tag* m_source;
+      mutable int m_pending;
 
       static const std::string& findLang( const StringMap* map,
                                           const std::string& defaultData,
@@ -164,9 +198,43 @@ namespace gloox
                             const std::string& defaultData,
                             const std::string& name, Tag* tag );
 
+      /**
+       * Serialization helpers for appendXml() implementations. appendAddresses() appends the
+       * 'to' and 'from' attributes, appendStartTagEnd() the given 'from' (if the Stanza has none)
+       * and namespace as well as the closing '>' of the start tag. appendEndTag() closes the
+       * element started at @c contents (the position right after the start tag), either as
+       * an empty element or with an end tag.
+       */
+      void appendAddresses( std::string& out ) const;
+      void appendStartTagEnd( std::string& out, const std::string& from,
+                              const std::string& xmlns ) const;
+      void appendExtensions( std::string& out ) const;
+      static void appendEndTag( std::string& out, std::string::size_type contents,
+                                const char* name );
+      static void appendAttribute( std::string& out, const char* name, const std::string& value );
+      static void appendElement( std::string& out, const char* name, const std::string& cdata,
+                                 const std::string& xmllang = EmptyString );
+      static void appendLangs( const StringMap* map,
+                               const std::string& defaultData,
+                               const char* name, std::string& out );
+
     private:
       Stanza( const Stanza& );
 
+      void decodeFrom() const;
+      void decodeTo() const;
+      void decodeExtensions() const;
+
+      /**
+       * Makes the Stanza create its StanzaExtensions using the given factory on first access
+       * instead of right away. The Tag passed to the constructor is used as source.
+       * @param factory The factory to create extensions with.
+       */
+      void deferExtensions( StanzaExtensionFactory* factory );
+
+      StanzaExtensionFactory* m_seFactory;
+      const StanzaExtension* m_extensionSlots[ExtUser]; // the first extension of each built-in type
+
   };
 
 }
@@ -0,0 +1,30 @@
+/*
+  Copyright (c) 2009 by Jakob Schroeter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#include "stanzaextension.h"
+#include "tag.h"
+
+namespace gloox
+{
+
+  void StanzaExtension::appendXml( std::string& out ) const
+  {
+    Tag* t = tag();
+    if( !t )
+      return;
+
+    t->appendXml( out );
+    delete t;
+  }
+
+}
@@ -216,6 +216,16 @@ namespace gloox
        */
       virtual Tag* tag() const = 0;
 
+      /**
+       * Appends the extension's XML representation to the given string. The default
+       * implementation serializes the result of tag(). Extensions that are sent frequently
+       * may re-implement this to write their XML directly, which is what Stanza::appendXml()
+       * uses.
+       * @param out The string to append to.
+       * @since 1.0
+       */
+      virtual void appendXml( std::string& out ) const;
+
       /**
        * Returns an identical copy of the current StanzaExtension.
        * @return An identical copy of the current StanzaExtension.
@@ -19,9 +19,26 @@
 #include "stanzaextension.h"
 #include "tag.h"
 
+#include <algorithm>
+
 namespace gloox
 {
 
+  static inline unsigned indexHash( unsigned h, const std::string& str )
+  {
+    for( std::string::size_type i = 0; i < str.length(); ++i )
+    {
+      h ^= static_cast<unsigned char>( str[i] );
+      h *= 16777619u;
+    }
+    // separator, so that e.g. ( "ab", "c" ) and ( "a", "bc" ) differ
+    h ^= 0xff;
+    h *= 16777619u;
+    return h;
+  }
+
+  static const unsigned IndexSeed = 2166136261u;
+
   StanzaExtensionFactory::StanzaExtensionFactory()
   {
   }
@@ -48,6 +65,7 @@ namespace gloox
       }
     }
     m_extensions.push_back( ext );
+    rebuildIndex();
   }
 
   bool StanzaExtensionFactory::removeExtension( int ext )
@@ -59,28 +77,194 @@ namespace gloox
       {
         delete (*it);
         m_extensions.erase( it );
+        rebuildIndex();
         return true;
       }
     }
     return false;
   }
 
+  static inline bool isSimpleNameChar( char c )
+  {
+    return ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' )
+           || c == '_' || c == '-';
+  }
+
+  static bool parseSimpleName( const std::string& path, std::string::size_type& pos,
+                               std::string& name )
+  {
+    std::string::size_type start = pos;
+    while( pos < path.length() && isSimpleNameChar( path[pos] ) )
+      ++pos;
+
+    // an all-digit step would be an index in XPath
+    if( pos == start || ( path[start] >= '0' && path[start] <= '9' ) )
+      return false;
+
+    name.assign( path, start, pos - start );
+    return true;
+  }
+
+  bool StanzaExtensionFactory::parseFilter( const std::string& filter, unsigned order,
+                                            StanzaExtension* ext, std::vector<IndexEntry>& entries )
+  {
+    static const std::string xmlnsPredicate = "[@xmlns='";
+
+    std::vector<IndexEntry> result;
+    std::string::size_type start = 0;
+    while( start <= filter.length() )
+    {
+      std::string::size_type end = filter.find( '|', start );
+      if( end == std::string::npos )
+        end = filter.length();
+      const std::string path( filter, start, end - start );
+      start = end + 1;
+
+      // accepted: /stanza/child and /stanza/child[@xmlns='namespace']
+      IndexEntry e;
+      e.order = order;
+      e.ext = ext;
+      std::string::size_type pos = 0;
+      if( pos >= path.length() || path[pos++] != '/' || !parseSimpleName( path, pos, e.stanza )
+          || pos >= path.length() || path[pos++] != '/' || !parseSimpleName( path, pos, e.name ) )
+        return false;
+
+      if( pos < path.length() )
+      {
+        if( path.compare( pos, xmlnsPredicate.length(), xmlnsPredicate ) )
+          return false;
+        pos += xmlnsPredicate.length();
+        std::string::size_type q = path.find( '\'', pos );
+        if( q == std::string::npos || q == pos || q + 2 != path.length() || path[q + 1] != ']' )
+          return false;
+        e.xmlns.assign( path, pos, q - pos );
+        if( e.xmlns.find_first_of( "\\[]|" ) != std::string::npos )
+          return false;
+      }
+
+      result.push_back( e );
+    }
+
+    entries.insert( entries.end(), result.begin(), result.end() );
+    return true;
+  }
+
+  void StanzaExtensionFactory::rebuildIndex()
+  {
+    m_index.clear();
+    m_complex.clear();
+
+    std::vector<IndexEntry> entries;
+    unsigned order = 0;
+    SEList::const_iterator it = m_extensions.begin();
+    for( ; it != m_extensions.end(); ++it, ++order )
+    {
+      const std::string& filter = (*it)->filterString();
+      if( filter.empty() )
+        continue;
+
+      if( !parseFilter( filter, order, (*it), entries ) )
+      {
+        ComplexEntry c;
+        c.order = order;
+        c.ext = (*it);
+        m_complex.push_back( c );
+      }
+    }
+
+    if( entries.empty() )
+      return;
+
+    unsigned size = 16;
+    while( size < 2 * entries.size() )
+      size <<= 1;
+    m_index.resize( size );
+
+    std::vector<IndexEntry>::const_iterator ite = entries.begin();
+    for( ; ite != entries.end(); ++ite )
+    {
+      unsigned h = indexHash( indexHash( indexHash( IndexSeed, (*ite).stanza ), (*ite).name ),
+                              (*ite).xmlns );
+      m_index[h & ( size - 1 )].push_back( (*ite) );
+    }
+  }
+
+  void StanzaExtensionFactory::match( const Tag* stanza, unsigned stanzaHash, const Tag* child,
+                                      const std::string& xmlns, MatchList& matches ) const
+  {
+    unsigned h = indexHash( indexHash( stanzaHash, child->name() ), xmlns );
+    const IndexBucket& b = m_index[h & ( m_index.size() - 1 )];
+    IndexBucket::const_iterator it = b.begin();
+    for( ; it != b.end(); ++it )
+    {
+      if( (*it).xmlns != xmlns || (*it).name != child->name() || (*it).stanza != stanza->name() )
+        continue;
+
+      // an extension may match the same child twice, e.g. with and without namespace.
+      // matches for the current child are at the end of the list
+      MatchList::size_type i = matches.size();
+      while( i > 0 && matches[i - 1].tag == child && matches[i - 1].ext != (*it).ext )
+        --i;
+      if( i > 0 && matches[i - 1].tag == child )
+        continue;
+
+      Match m;
+      m.order = (*it).order;
+      m.ext = (*it).ext;
+      m.tag = child;
+      matches.push_back( m );
+    }
+  }
+
   void StanzaExtensionFactory::addExtensions( Stanza& stanza, Tag* tag )
   {
-    ConstTagList match;
-    ConstTagList::const_iterator it;
-    SEList::const_iterator ite = m_extensions.begin();
-    for( ; ite != m_extensions.end(); ++ite )
+    if( !tag )
+      return;
+
+    MatchList matches;
+
+    if( !m_index.empty() )
     {
-      match = tag->findTagList( (*ite)->filterString() );
-      it = match.begin();
-      for( ; it != match.end(); ++it )
+      const unsigned stanzaHash = indexHash( IndexSeed, tag->name() );
+      const TagList& children = tag->children();
+      TagList::const_iterator it = children.begin();
+      for( ; it != children.end(); ++it )
       {
-        StanzaExtension* se = (*ite)->newInstance( (*it) );
-        if( se )
-          stanza.addExtension( se );
+        const std::string& xmlns = (*it)->findAttribute( XMLNS );
+        match( tag, stanzaHash, (*it), xmlns, matches );
+        if( !xmlns.empty() )
+          match( tag, stanzaHash, (*it), EmptyString, matches );
       }
     }
+
+    if( !m_complex.empty() )
+    {
+      std::vector<ComplexEntry>::const_iterator itc = m_complex.begin();
+      for( ; itc != m_complex.end(); ++itc )
+      {
+        const ConstTagList& l = tag->findTagList( (*itc).ext->filterString() );
+        ConstTagList::const_iterator it = l.begin();
+        for( ; it != l.end(); ++it )
+        {
+          Match m;
+          m.order = (*itc).order;
+          m.ext = (*itc).ext;
+          m.tag = (*it);
+          matches.push_back( m );
+        }
+      }
+    }
+
+    // keep the extensions in registration order
+    std::stable_sort( matches.begin(), matches.end(), orderLess );
+
+    MatchList::const_iterator it = matches.begin();
+    for( ; it != matches.end(); ++it )
+    {
+      StanzaExtension* se = (*it).ext->newInstance( (*it).tag );
+      if( se )
+        stanza.addExtension( se );
+    }
   }
 
 }
@@ -15,6 +15,8 @@
 #define STANZAEXTENSIONFACTORY_H__
 
 #include <list>
+#include <string>
+#include <vector>
 
 namespace gloox
 {
@@ -74,6 +76,10 @@ namespace gloox
 
       /**
        * This function creates StanzaExtensions from the given Tag and attaches them to the given Stanza.
+       * Extensions whose filter string only consists of (a union of) paths of the form
+       * <tt>/stanza/child</tt> or <tt>/stanza/child[@xmlns='namespace']</tt> are found using an
+       * index built at registration time. Only extensions with other filters are
+       * evaluated using XPath.
        * @param stanza The Stanza to attach the extensions to.
        * @param tag The Tag to parse and create the StanzaExtension from.
        */
@@ -81,7 +87,42 @@ namespace gloox
 
     private:
       typedef std::list<StanzaExtension*> SEList;
+
+      struct IndexEntry
+      {
+        std::string stanza;
+        std::string name;
+        std::string xmlns;
+        unsigned order;
+        StanzaExtension* ext;
+      };
+      typedef std::vector<IndexEntry> IndexBucket;
+
+      struct ComplexEntry
+      {
+        unsigned order;
+        StanzaExtension* ext;
+      };
+
+      struct Match
+      {
+        unsigned order;
+        StanzaExtension* ext;
+        const Tag* tag;
+      };
+      typedef std::vector<Match> MatchList;
+
+      void rebuildIndex();
+      void match( const Tag* stanza, unsigned stanzaHash, const Tag* child,
+                  const std::string& xmlns, MatchList& matches ) const;
+      static bool parseFilter( const std::string& filter, unsigned order, StanzaExtension* ext,
+                               std::vector<IndexEntry>& entries );
+      static bool orderLess( const Match& left, const Match& right )
+        { return left.order < right.order; }
+
       SEList m_extensions;
+      std::vector<IndexBucket> m_index;
+      std::vector<ComplexEntry> m_complex;
 
   };
 
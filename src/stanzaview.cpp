@@ -0,0 +1,103 @@
+/*
+  Copyright (c) 2009 by Jakob Schroeter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#include "stanzaview.h"
+#include "parser.h"
+#include "tag.h"
+#include "taghandler.h"
+
+namespace gloox
+{
+
+  // keeps the single top-level Tag a Parser produces
+  class StanzaViewTagHandler : public TagHandler
+  {
+    public:
+      StanzaViewTagHandler() : m_tag( 0 ) {}
+      virtual ~StanzaViewTagHandler() { delete m_tag; }
+      virtual void handleTag( Tag* tag ) { delete m_tag; m_tag = tag; }
+      Tag* take() { Tag* t = m_tag; m_tag = 0; return t; }
+
+    private:
+      Tag* m_tag;
+  };
+
+  const StanzaView::Attribute* StanzaView::findAttr( const std::string& name ) const
+  {
+    AttributeList::const_iterator it = m_attributes.begin();
+    for( ; it != m_attributes.end(); ++it )
+    {
+      if( (*it).nameLength == name.length()
+          && !m_xml.compare( (*it).nameBegin, (*it).nameLength, name ) )
+        return &(*it);
+    }
+
+    return 0;
+  }
+
+  const std::string StanzaView::findAttribute( const std::string& name ) const
+  {
+    const Attribute* a = findAttr( name );
+    if( !a )
+      return EmptyString;
+
+    if( a->escaped )
+      return a->value;
+
+    return m_xml.substr( a->valueBegin, a->valueLength );
+  }
+
+  const StanzaView::Element* StanzaView::findChild( const std::string& name,
+                                                    const std::string& xmlns ) const
+  {
+    ElementList::const_iterator it = m_children.begin();
+    for( ; it != m_children.end(); ++it )
+    {
+      if( (*it).name == name && ( xmlns.empty() || (*it).xmlns == xmlns ) )
+        return &(*it);
+    }
+
+    return 0;
+  }
+
+  Tag* StanzaView::parse( std::string::size_type begin, std::string::size_type length ) const
+  {
+    StanzaViewTagHandler th;
+    Parser p( &th, false );
+    if( p.feed( m_xml.data() + begin, length ) >= 0 )
+      return 0;
+
+    return th.take();
+  }
+
+  Tag* StanzaView::tag() const
+  {
+    if( m_xml.empty() )
+      return 0;
+
+    return parse( 0, m_xml.length() );
+  }
+
+  Tag* StanzaView::tag( const Element& child ) const
+  {
+    if( child.end > m_xml.length() || child.begin >= child.end )
+      return 0;
+
+    Tag* t = parse( child.begin, child.end - child.begin );
+    if( t && t->xmlns().empty() && !child.xmlns.empty() )
+      t->setXmlns( child.xmlns, t->prefix() );
+
+    return t;
+  }
+
+}
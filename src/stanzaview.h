@@ -0,0 +1,170 @@
+/*
+  Copyright (c) 2009 by Jakob Schroeter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef STANZAVIEW_H__
+#define STANZAVIEW_H__
+
+#include "gloox.h"
+
+#include <string>
+#include <vector>
+
+namespace gloox
+{
+
+  class Tag;
+
+  /**
+   * @brief A lightweight, read-only index into the raw XML of a top-level element.
+   *
+   * A StanzaView holds the bytes of an element exactly as they were received, together with
+   * the element's name and namespace, the positions of its attributes and the positions,
+   * names and namespaces of its direct children. Nothing else is decoded. Tags are only built
+   * when asked for, either for the whole element (see tag()) or for a single child
+   * (see tag( const Element& )).
+   *
+   * This allows components which route stanzas based on a few attributes and the
+   * namespace of the payload to look at these and then pass xml() on unchanged, without
+   * building and re-serializing a Tag tree.
+   *
+   * StanzaViews are produced by a Parser, see Parser::setStanzaViewHandler().
+   *
+   * @author Jakob Schroeter <js@camaya.net>
+   * @since 1.0
+   */
+  class GLOOX_API StanzaView
+  {
+    friend class Parser;
+
+    public:
+      /**
+       * Describes a direct child of the viewed element.
+       */
+      struct Element
+      {
+        std::string name;                 /**< The child's (local) name. */
+        std::string xmlns;                /**< The child's namespace. */
+        std::string::size_type begin;     /**< The offset of the child's opening '<' in xml(). */
+        std::string::size_type end;       /**< The offset just past the child's closing '>'. */
+      };
+
+      /**
+       * A list of child elements.
+       */
+      typedef std::vector<Element> ElementList;
+
+      /**
+       * Creates an empty view.
+       */
+      StanzaView() {}
+
+      /**
+       * Returns the raw XML of the element, exactly as received.
+       * @return The raw XML.
+       */
+      const std::string& xml() const { return m_xml; }
+
+      /**
+       * Returns the element's (local) name.
+       * @return The element's name.
+       */
+      const std::string& name() const { return m_name; }
+
+      /**
+       * Returns the element's namespace, if it is declared on the element.
+       * @return The element's namespace.
+       */
+      const std::string& xmlns() const { return m_xmlns; }
+
+      /**
+       * Returns the (unescaped) value of the element's attribute with the given name.
+       * @param name The attribute's name, including the prefix, if any (e.g. 'xml:lang').
+       * @return The attribute's value, or an empty string if there is no such attribute.
+       */
+      const std::string findAttribute( const std::string& name ) const;
+
+      /**
+       * Checks whether the element has an attribute with the given name.
+       * @param name The attribute's name, including the prefix, if any.
+       * @return @b True if the attribute exists, @b false otherwise.
+       */
+      bool hasAttribute( const std::string& name ) const { return findAttr( name ) != 0; }
+
+      /**
+       * Returns the element's direct children, in document order.
+       * @return The element's children.
+       */
+      const ElementList& children() const { return m_children; }
+
+      /**
+       * Returns the first direct child with the given name (and namespace).
+       * @param name The child's name.
+       * @param xmlns The child's namespace. If empty, any namespace matches.
+       * @return The child, or 0 if there is none.
+       */
+      const Element* findChild( const std::string& name,
+                                const std::string& xmlns = EmptyString ) const;
+
+      /**
+       * Parses the whole element into a Tag tree.
+       * @return A new Tag tree, or 0 if the view is empty. You are responsible
+       * for deleting it.
+       */
+      Tag* tag() const;
+
+      /**
+       * Parses a single child into a Tag tree. The child's namespace is set on the
+       * resulting Tag if it was inherited from the viewed element.
+       * @param child One of the elements returned by children().
+       * @return A new Tag tree, or 0 if the child could not be parsed. You are responsible
+       * for deleting it.
+       */
+      Tag* tag( const Element& child ) const;
+
+    private:
+      // an attribute of the viewed element, as offsets into m_xml. The value is only
+      // stored if it differs from the raw bytes, i.e. if it contains entities.
+      struct Attribute
+      {
+        std::string::size_type nameBegin;
+        std::string::size_type nameLength;
+        std::string::size_type valueBegin;
+        std::string::size_type valueLength;
+        std::string value;
+        bool escaped;
+      };
+      typedef std::vector<Attribute> AttributeList;
+
+      const Attribute* findAttr( const std::string& name ) const;
+      Tag* parse( std::string::size_type begin, std::string::size_type length ) const;
+
+      void clear()
+      {
+        m_xml.clear();
+        m_name.clear();
+        m_xmlns.clear();
+        m_attributes.clear();
+        m_children.clear();
+      }
+
+      std::string m_xml;
+      std::string m_name;
+      std::string m_xmlns;
+      AttributeList m_attributes;
+      ElementList m_children;
+
+  };
+
+}
+
+#endif // STANZAVIEW_H__
@@ -0,0 +1,51 @@
+/*
+  Copyright (c) 2009 by Jakob Schroeter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef STANZAVIEWHANDLER_H__
+#define STANZAVIEWHANDLER_H__
+
+#include "stanzaview.h"
+
+namespace gloox
+{
+
+  /**
+   * @brief A virtual interface which can be reimplemented to receive top-level elements as
+   * StanzaViews instead of as Tag trees.
+   *
+   * See Parser::setStanzaViewHandler().
+   *
+   * @author Jakob Schroeter <js@camaya.net>
+   * @since 1.0
+   */
+  class GLOOX_API StanzaViewHandler
+  {
+    public:
+      /**
+       * Virtual Destructor.
+       */
+      virtual ~StanzaViewHandler() {}
+
+      /**
+       * This function is called for every complete top-level element.
+       * The view is re-used by the Parser for the next element. If you need it afterwards,
+       * copy it.
+       * @param view The element's view.
+       */
+      virtual void handleStanzaView( const StanzaView& view ) = 0;
+
+  };
+
+}
+
+#endif // STANZAVIEWHANDLER_H__
@@ -21,18 +21,31 @@ namespace gloox
     "subscribe", "subscribed", "unsubscribe", "unsubscribed"
   };
 
+  static const util::LookupTable msgTypeTable( msgTypeStringValues );
+
   static inline const std::string typeString( Subscription::S10nType type )
   {
     return util::lookup( type, msgTypeStringValues );
   }
 
-  Subscription::Subscription( Tag* tag )
-    : Stanza( tag ), m_subtype( Invalid ), m_stati( 0 )
+  Subscription::Subscription( Tag* tag, bool lazy )
+    : Stanza( tag, lazy ), m_subtype( Invalid ), m_stati( 0 )
   {
     if( !tag || tag->name() != "presence" )
+    {
+      m_pending &= ~PendingPayload;
       return;
+    }
+
+    m_subtype = (S10nType)msgTypeTable.find( tag->findAttribute( TYPE ) );
 
-    m_subtype = (S10nType)util::lookup( tag->findAttribute( TYPE ), msgTypeStringValues );
+    if( !lazy )
+      parsePayload( tag );
+  }
+
+  void Subscription::parsePayload( const Tag* tag )
+  {
+    m_pending &= ~PendingPayload;
 
     const ConstTagList& c = tag->findTagList( "/presence/status" );
     ConstTagList::const_iterator it = c.begin();
@@ -57,21 +70,44 @@ namespace gloox
     if( m_subtype == Invalid )
       return 0;
 
+    decode();
+
     Tag* t = new Tag( "presence" );
-    if( m_to )
+    if( to() )
       t->addAttribute( "to", m_to.full() );
-    if( m_from )
+    if( from() )
       t->addAttribute( "from", m_from.full() );
 
     t->addAttribute( "type", typeString( m_subtype ) );
 
     getLangs( m_stati, m_status, "status", t );
 
-    StanzaExtensionList::const_iterator it = m_extensionList.begin();
+    StanzaExtensionList::const_iterator it = extensions().begin();
     for( ; it != m_extensionList.end(); ++it )
       t->addChild( (*it)->tag() );
 
     return t;
   }
 
+  bool Subscription::appendXml( std::string& out, const std::string& from,
+                                const std::string& xmlns ) const
+  {
+    if( m_subtype == Invalid )
+      return false;
+
+    decode();
+
+    out += "<presence";
+    appendAddresses( out );
+    appendAttribute( out, "type", typeString( m_subtype ) );
+    appendStartTagEnd( out, from, xmlns );
+    const std::string::size_type contents = out.length();
+
+    appendLangs( m_stati, m_status, "status", out );
+
+    appendExtensions( out );
+    appendEndTag( out, contents, "presence" );
+    return true;
+  }
+
 }
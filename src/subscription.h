@@ -79,12 +79,17 @@ namespace gloox
        */
       const std::string status( const std::string& lang = "default" ) const
       {
+        decode();
         return findLang( m_stati, m_status, lang );
       }
 
       // reimplemented from Stanza
       virtual Tag* tag() const;
 
+      // reimplemented from Stanza
+      virtual bool appendXml( std::string& out, const std::string& from = EmptyString,
+                              const std::string& xmlns = EmptyString ) const;
+
     private:
 #ifdef SUBSCRIPTION_TEST
     public:
@@ -93,7 +98,11 @@ namespace gloox
        * Creates a Subscription request from the given Tag. The original Tag will be ripped off.
        * @param tag The Tag to parse.
        */
-      Subscription( Tag* tag );
+      Subscription( Tag* tag, bool lazy = false );
+
+      void decode() const
+        { if( m_pending & PendingPayload ) const_cast<Subscription*>( this )->parsePayload( m_source ); }
+      void parsePayload( const Tag* tag );
 
       S10nType m_subtype;
       StringMap* m_stati;
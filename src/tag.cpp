@@ -12,15 +12,60 @@
 
 
 #include "tag.h"
+#include "tagarena.h"
+#include "compiledxpath.h"
+#include "mutex.h"
+#include "mutexguard.h"
 #include "util.h"
 
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+# include <windows.h>
+#endif
+
+#ifdef _WIN32_WCE
+# include <winbase.h>
+#endif
 
 #include <algorithm>
+#include <vector>
 
 namespace gloox
 {
 
+  /*
+   * Every Tag, Attribute and Node is preceded by a header recording the TagArena it was
+   * allocated from (0 for the heap), so that a plain delete can tell whether to free it.
+   */
+  union ArenaHeader
+  {
+    TagArena* arena;
+    double d;
+    long l;
+    void* p;
+  };
+
+  static void* arenaAllocate( std::size_t size, TagArena* arena )
+  {
+    const std::size_t total = sizeof( ArenaHeader ) + size;
+    ArenaHeader* h = static_cast<ArenaHeader*>( arena ? arena->allocate( total )
+                                                      : ::operator new( total ) );
+    h->arena = arena;
+    return h + 1;
+  }
+
+  static void arenaFree( void* p )
+  {
+    if( !p )
+      return;
+
+    ArenaHeader* h = static_cast<ArenaHeader*>( p ) - 1;
+    if( !h->arena )
+      ::operator delete( h );
+  }
+
   // ---- Tag::Attribute ----
   Tag::Attribute::Attribute( Tag* parent, const std::string& name, const std::string& value,
                              const std::string& xmlns )
@@ -45,6 +90,26 @@ namespace gloox
   {
   }
 
+  void* Tag::Attribute::operator new( std::size_t size )
+  {
+    return arenaAllocate( size, 0 );
+  }
+
+  void* Tag::Attribute::operator new( std::size_t size, TagArena* arena )
+  {
+    return arenaAllocate( size, arena );
+  }
+
+  void Tag::Attribute::operator delete( void* p )
+  {
+    arenaFree( p );
+  }
+
+  void Tag::Attribute::operator delete( void* p, TagArena* /*arena*/ )
+  {
+    arenaFree( p );
+  }
+
   void Tag::Attribute::init( const std::string& name, const std::string& value,
                              const std::string& xmlns )
   {
@@ -70,6 +135,8 @@ namespace gloox
       return false;
 
     m_value = value;
+    if( m_parent )
+      m_parent->invalidateXml();
     return true;
   }
 
@@ -88,16 +155,18 @@ namespace gloox
       return false;
 
     m_prefix = prefix;
+    if( m_parent )
+      m_parent->invalidateXml();
     return true;
   }
 
   const std::string& Tag::Attribute::xmlns() const
   {
     if( !m_xmlns.empty() )
-      return m_xmlns;
+      return m_xmlns.str();
 
     if( m_parent )
-      return m_parent->xmlns( m_prefix );
+      return m_parent->xmlns( m_prefix.str() );
 
     return EmptyString;
   }
@@ -105,40 +174,216 @@ namespace gloox
   const std::string& Tag::Attribute::prefix() const
   {
     if( !m_prefix.empty() )
-      return m_prefix;
+      return m_prefix.str();
 
     if( m_parent )
-      return m_parent->prefix( m_xmlns );
+      return m_parent->prefix( m_xmlns.str() );
 
     return EmptyString;
   }
 
   const std::string Tag::Attribute::xml() const
+  {
+    std::string xml;
+    appendXml( xml );
+    return xml;
+  }
+
+  void Tag::Attribute::appendXml( std::string& out ) const
   {
     if( m_name.empty() )
-      return EmptyString;
+      return;
 
-    std::string xml;
-    xml += ' ';
+    out += ' ';
     if( !m_prefix.empty() )
     {
-      xml += m_prefix;
-      xml += ':';
+      out += m_prefix.str();
+      out += ':';
     }
-    xml += m_name;
-    xml += "='";
-    xml += util::escape( m_value );
-    xml += '\'';
-
-    return xml;
+    out += m_name.str();
+    out += "='";
+    util::appendEscaped( out, m_value );
+    out += '\'';
   }
   // ---- ~Tag::Attribute ----
 
   // ---- Tag ----
+  void Tag::NamespaceScope::release( NamespaceScope* scope )
+  {
+    while( scope && --scope->refs == 0 )
+    {
+      NamespaceScope* parent = scope->parent;
+      delete scope;
+      scope = parent;
+    }
+  }
+
+  Tag::NamespaceScope* Tag::NamespaceScope::copy( const NamespaceScope* scope )
+  {
+    std::vector<const NamespaceScope*> chain;
+    for( ; scope; scope = scope->parent )
+      chain.push_back( scope );
+
+    NamespaceScope* c = 0;
+    std::vector<const NamespaceScope*>::const_reverse_iterator it = chain.rbegin();
+    for( ; it != chain.rend(); ++it )
+      c = push( c, (*it)->prefix, (*it)->xmlns );
+    return c;
+  }
+
+#if !defined( _WIN32 ) && !defined( _WIN32_WCE ) \
+    && !( defined( __GNUC__ ) && ( __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 1 ) ) )
+  // protects the reference counts of shared contents where there are no atomic operations
+  static util::Mutex sharedMutex;
+#endif
+
+  long Tag::SharedData::addRefs( SharedData* shared, long delta )
+  {
+#if defined( _WIN32 ) || defined( _WIN32_WCE )
+    return InterlockedExchangeAdd( &shared->refs, delta ) + delta;
+#elif defined( __GNUC__ ) && ( __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 1 ) )
+    return __sync_add_and_fetch( &shared->refs, delta );
+#else
+    util::MutexGuard m( sharedMutex );
+    return shared->refs += delta;
+#endif
+  }
+
+  void Tag::SharedData::release( SharedData* shared )
+  {
+    if( addRefs( shared, -1 ) )
+      return;
+
+    delete shared->tag;
+    delete shared;
+  }
+
+  /*
+   * A name to look up, given either as std::string or as C string. The Atom table is
+   * searched once per lookup, not once per candidate.
+   */
+  struct Tag::NameRef
+  {
+    NameRef( const std::string& name )
+      : data( name.data() ), length( name.length() ), atom( Atom::find( data, length ) ) {}
+    NameRef( const char* name )
+      : data( name ), length( strlen( name ) ), atom( Atom::find( data, length ) ) {}
+
+    const char* data;
+    std::string::size_type length;
+    const std::string* atom;
+  };
+
+  // Tags get a ChildIndex once they have this many child elements
+  static const unsigned ChildIndexThreshold = 32;
+
+  /*
+   * Maps names to the child elements with that name, in document order. A hash table with
+   * open addressing and one slot per distinct name. Slots are never freed, only emptied.
+   */
+  class Tag::ChildIndex
+  {
+    public:
+      ChildIndex() : m_slots( 16 ), m_used( 0 ) {}
+
+      void add( Tag* child )
+      {
+        if( 2 * ( m_used + 1 ) > m_slots.size() )
+          grow();
+
+        const std::string& name = child->m_name.str();
+        Slot& s = m_slots[position( name.data(), name.length() )];
+        if( !s.used )
+        {
+          s.used = true;
+          s.name = name;
+          ++m_used;
+        }
+        s.tags.push_back( child );
+      }
+
+      void remove( Tag* child )
+      {
+        const std::string& name = child->m_name.str();
+        std::vector<Tag*>& tags = m_slots[position( name.data(), name.length() )].tags;
+        std::vector<Tag*>::iterator it = std::find( tags.begin(), tags.end(), child );
+        if( it != tags.end() )
+          tags.erase( it );
+      }
+
+      const std::vector<Tag*>* find( const NameRef& name ) const
+      {
+        const Slot& s = m_slots[position( name.data, name.length )];
+        return s.tags.empty() ? 0 : &s.tags;
+      }
+
+    private:
+      struct Slot
+      {
+        Slot() : used( false ) {}
+        std::string name;
+        std::vector<Tag*> tags;
+        bool used;
+      };
+
+      unsigned position( const char* name, std::string::size_type length ) const
+      {
+        const unsigned mask = static_cast<unsigned>( m_slots.size() ) - 1;
+        unsigned h = 2166136261u;
+        for( std::string::size_type i = 0; i < length; ++i )
+        {
+          h ^= static_cast<unsigned char>( name[i] );
+          h *= 16777619u;
+        }
+
+        unsigned s = h & mask;
+        while( m_slots[s].used && ( m_slots[s].name.length() != length
+                                    || m_slots[s].name.compare( 0, length, name, length ) != 0 ) )
+          s = ( s + 1 ) & mask;
+        return s;
+      }
+
+      void grow()
+      {
+        std::vector<Slot> old( m_slots.size() * 2 );
+        old.swap( m_slots );
+        std::vector<Slot>::iterator it = old.begin();
+        for( ; it != old.end(); ++it )
+        {
+          if( !(*it).used )
+            continue;
+
+          Slot& s = m_slots[position( (*it).name.data(), (*it).name.length() )];
+          s.used = true;
+          s.name.swap( (*it).name );
+          s.tags.swap( (*it).tags );
+        }
+      }
+
+      std::vector<Slot> m_slots;
+      unsigned m_used;
+  };
+
+  void* Tag::allocateStorage( std::size_t size, TagArena* arena )
+  {
+    return arenaAllocate( size, arena );
+  }
+
+  void Tag::freeStorage( void* p )
+  {
+    arenaFree( p );
+  }
+
+  const Tag::Node* Tag::nextNode( const Node* it, const Node* end, NodeType type )
+  {
+    while( it != end && it->type != type )
+      ++it;
+    return it;
+  }
+
   Tag::Tag( const std::string& name, const std::string& cdata )
-    : m_parent( 0 ), m_children( 0 ), m_cdata( 0 ),
-      m_attribs( 0 ), m_nodes( 0 ),
-      m_xmlnss( 0 )
+    : m_parent( 0 ), m_childView( 0 ), m_attribView( 0 ), m_childIndex( 0 ), m_shared( 0 ), m_xmlCache( 0 ),
+      m_scope( 0 ), m_arena( 0 )
   {
     addCData( cdata ); // implicitly UTF-8 checked
 
@@ -147,9 +392,8 @@ namespace gloox
   }
 
   Tag::Tag( Tag* parent, const std::string& name, const std::string& cdata )
-    : m_parent( parent ), m_children( 0 ), m_cdata( 0 ),
-      m_attribs( 0 ), m_nodes( 0 ),
-      m_xmlnss( 0 )
+    : m_parent( parent ), m_childView( 0 ), m_attribView( 0 ), m_childIndex( 0 ), m_shared( 0 ), m_xmlCache( 0 ),
+      m_scope( 0 ), m_arena( 0 )
   {
     if( m_parent )
       m_parent->addChild( this );
@@ -163,9 +407,8 @@ namespace gloox
   Tag::Tag( const std::string& name,
             const std::string& attrib,
             const std::string& value )
-    : m_parent( 0 ), m_children( 0 ), m_cdata( 0 ),
-      m_attribs( 0 ), m_nodes( 0 ),
-      m_name( name ), m_xmlnss( 0 )
+    : m_parent( 0 ), m_childView( 0 ), m_attribView( 0 ), m_childIndex( 0 ), m_shared( 0 ), m_xmlCache( 0 ),
+      m_name( name ), m_scope( 0 ), m_arena( 0 )
   {
     addAttribute( attrib, value ); // implicitly UTF-8 checked
 
@@ -176,9 +419,8 @@ namespace gloox
   Tag::Tag( Tag* parent, const std::string& name,
                          const std::string& attrib,
                          const std::string& value )
-    : m_parent( parent ), m_children( 0 ), m_cdata( 0 ),
-      m_attribs( 0 ), m_nodes( 0 ),
-      m_name( name ), m_xmlnss( 0 )
+    : m_parent( parent ), m_childView( 0 ), m_attribView( 0 ), m_childIndex( 0 ), m_shared( 0 ), m_xmlCache( 0 ),
+      m_name( name ), m_scope( 0 ), m_arena( 0 )
   {
     if( m_parent )
       m_parent->addChild( this );
@@ -190,168 +432,277 @@ namespace gloox
   }
 
   Tag::Tag( Tag* tag )
-    : m_parent( 0 ), m_children( 0 ), m_cdata( 0 ), m_attribs( 0 ),
-      m_nodes( 0 ), m_xmlnss( 0 )
+    : m_parent( 0 ), m_childView( 0 ), m_attribView( 0 ), m_childIndex( 0 ), m_shared( 0 ), m_xmlCache( 0 ), m_scope( 0 ), m_arena( 0 )
   {
     if( !tag )
       return;
 
-    m_children = tag->m_children;
-    m_cdata = tag->m_cdata;
-    m_attribs = tag->m_attribs;
-    m_nodes = tag->m_nodes;
+    m_arena = tag->m_arena;
+    takeContents( tag );
+    m_shared = tag->m_shared;
     m_name = tag->m_name;
     m_xmlns = tag->m_xmlns;
-    m_xmlnss = tag->m_xmlnss;
-
-    tag->m_nodes = 0;
-    tag->m_cdata = 0;
-    tag->m_attribs = 0;
-    tag->m_children = 0;
-    tag->m_xmlnss = 0;
+    m_scope = tag->m_scope;
 
-    if( m_attribs )
+    if( m_shared && m_shared->owner == tag )
     {
-      AttributeList::iterator it = m_attribs->begin();
-      while( it != m_attribs->end() )
-        (*it++)->m_parent = this;
+      m_shared->owner = this;
+      m_shared->tag->setContentParent( this );
     }
 
-    if( m_children )
-    {
-      TagList::iterator it = m_children->begin();
-      while( it != m_children->end() )
-        (*it++)->m_parent = this;
-    }
+    tag->m_shared = 0;
+    tag->m_scope = 0;
   }
 
   Tag::~Tag()
   {
-    if( m_cdata )
-      util::clearList( *m_cdata );
-    if( m_attribs )
-      util::clearList( *m_attribs );
-    if( m_children )
-      util::clearList( *m_children );
-    if( m_nodes )
-      util::clearList( *m_nodes );
-
-    delete m_cdata;
-    delete m_attribs;
-    delete m_children;
-    delete m_nodes;
-    delete m_xmlnss;
+    Node* it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+    {
+      if( it->type == TypeTag )
+        delete it->tag;
+      else
+        delete it->str;
+    }
+
+    Attribute** at = m_attribs.begin();
+    for( ; at != m_attribs.end(); ++at )
+      delete (*at);
+
+    delete m_childView;
+    delete m_attribView;
+    delete m_childIndex;
+    NamespaceScope::release( m_scope );
+    delete m_xmlCache;
+
+    if( m_shared )
+      releaseShared();
 
     m_parent = 0;
   }
 
+  void* Tag::operator new( std::size_t size )
+  {
+    return arenaAllocate( size, 0 );
+  }
+
+  void* Tag::operator new( std::size_t size, TagArena* arena )
+  {
+    return arenaAllocate( size, arena );
+  }
+
+  void Tag::operator delete( void* p )
+  {
+    arenaFree( p );
+  }
+
+  void Tag::operator delete( void* p, TagArena* /*arena*/ )
+  {
+    arenaFree( p );
+  }
+
   bool Tag::operator==( const Tag& right ) const
   {
     if( m_name != right.m_name || m_xmlns != right.m_xmlns )
       return false;
 
-    if( m_cdata && right.m_cdata )
+    const Tag* l = content();
+    const Tag* r = right.content();
+    if( l == r )
+      return true;
+
+    // character data and child elements are compared separately, their interleaving doesn't matter
+    const Node* ct = nextNode( l->m_nodes.begin(), l->m_nodes.end(), TypeString );
+    const Node* ct_r = nextNode( r->m_nodes.begin(), r->m_nodes.end(), TypeString );
+    while( ct != l->m_nodes.end() && ct_r != r->m_nodes.end() && *(ct->str) == *(ct_r->str) )
     {
-      StringPList::const_iterator ct = m_cdata->begin();
-      StringPList::const_iterator ct_r = right.m_cdata->begin();
-      while( ct != m_cdata->end() && ct_r != right.m_cdata->end() && *(*ct) == *(*ct_r) )
-      {
-        ++ct;
-        ++ct_r;
-      }
-      if( ct != m_cdata->end() )
-        return false;
+      ct = nextNode( ct + 1, l->m_nodes.end(), TypeString );
+      ct_r = nextNode( ct_r + 1, r->m_nodes.end(), TypeString );
     }
-    else if( m_cdata || right.m_cdata )
+    if( ct != l->m_nodes.end() || ct_r != r->m_nodes.end() )
       return false;
 
-    if( m_children && right.m_children )
+    const Node* it = nextNode( l->m_nodes.begin(), l->m_nodes.end(), TypeTag );
+    const Node* it_r = nextNode( r->m_nodes.begin(), r->m_nodes.end(), TypeTag );
+    while( it != l->m_nodes.end() && it_r != r->m_nodes.end() && *(it->tag) == *(it_r->tag) )
     {
-      TagList::const_iterator it = m_children->begin();
-      TagList::const_iterator it_r = right.m_children->begin();
-      while( it != m_children->end() && it_r != right.m_children->end() && *(*it) == *(*it_r) )
-      {
-        ++it;
-        ++it_r;
-      }
-      if( it != m_children->end() )
-        return false;
+      it = nextNode( it + 1, l->m_nodes.end(), TypeTag );
+      it_r = nextNode( it_r + 1, r->m_nodes.end(), TypeTag );
     }
-    else if( m_children || right.m_children )
+    if( it != l->m_nodes.end() || it_r != r->m_nodes.end() )
       return false;
 
-    if( m_attribs && right.m_attribs )
-    {
-      AttributeList::const_iterator at = m_attribs->begin();
-      AttributeList::const_iterator at_r = right.m_attribs->begin();
-      while( at != m_attribs->end() && at_r != right.m_attribs->end() && *(*at) == *(*at_r) )
-      {
-        ++at;
-        ++at_r;
-      }
-      if( at != m_attribs->end() )
-        return false;
-    }
-    else if( m_attribs || right.m_attribs )
+    if( l->m_attribs.size() != r->m_attribs.size() )
       return false;
 
+    for( unsigned i = 0; i < l->m_attribs.size(); ++i )
+      if( !( *l->m_attribs[i] == *r->m_attribs[i] ) )
+        return false;
+
     return true;
   }
 
   const std::string Tag::xml() const
+  {
+    std::string xml;
+    appendXml( xml );
+    return xml;
+  }
+
+  void Tag::appendXml( std::string& out ) const
   {
     if( m_name.empty() )
-      return EmptyString;
+      return;
 
-    std::string xml = "<";
-    if( !m_prefix.empty() )
+    // escaping may add to this, but usually the buffer needs to grow once at most
+    out.reserve( out.length() + xmlSize() );
+    serialize( out );
+  }
+
+  void Tag::setXmlCaching( bool cache )
+  {
+    if( cache && !m_xmlCache )
+      m_xmlCache = new std::string();
+    else if( !cache )
     {
-      xml += m_prefix;
-      xml += ':';
+      delete m_xmlCache;
+      m_xmlCache = 0;
     }
-    xml += m_name;
-    if( m_attribs && !m_attribs->empty() )
+  }
+
+  void Tag::invalidateXml()
+  {
+    for( Tag* t = this; t; t = t->m_parent )
+      if( t->m_xmlCache )
+        t->m_xmlCache->clear();
+  }
+
+  std::string::size_type Tag::xmlSize() const
+  {
+    if( m_xmlCache && !m_xmlCache->empty() )
+      return m_xmlCache->length();
+
+    const Tag* c = content();
+    const std::string::size_type tagName = m_prefix.empty() ? m_name.str().length()
+                                             : m_prefix.str().length() + 1 + m_name.str().length();
+
+    // <name + contents + </name>
+    if( m_shared )
+      return tagName + 1 + m_shared->xml.length() + ( c->m_nodes.empty() ? 0 : tagName + 3 );
+
+    std::string::size_type size = tagName + 3; // <name/>
+
+    const Attribute* const* it_a = c->m_attribs.begin();
+    for( ; it_a != c->m_attribs.end(); ++it_a )
     {
-      AttributeList::const_iterator it_a = m_attribs->begin();
-      for( ; it_a != m_attribs->end(); ++it_a )
-      {
-        xml += (*it_a)->xml();
-      }
+      // ' prefix:name='value'
+      size += (*it_a)->m_name.str().length() + (*it_a)->m_value.length() + 4;
+      if( !(*it_a)->m_prefix.empty() )
+        size += (*it_a)->m_prefix.str().length() + 1;
     }
 
-    if( !m_nodes || m_nodes->empty() )
-      xml += "/>";
-    else
+    if( !c->m_nodes.empty() )
     {
-      xml += '>';
-      NodeList::const_iterator it_n = m_nodes->begin();
-      for( ; it_n != m_nodes->end(); ++it_n )
+      size += tagName + 2; // ></name>
+      const Node* it_n = c->m_nodes.begin();
+      for( ; it_n != c->m_nodes.end(); ++it_n )
       {
-        switch( (*it_n)->type )
+        switch( it_n->type )
         {
           case TypeTag:
-            xml += (*it_n)->tag->xml();
+            size += it_n->tag->xmlSize();
             break;
           case TypeString:
-            xml += util::escape( *((*it_n)->str) );
+            size += it_n->str->length();
             break;
         }
       }
-      xml += "</";
+    }
+
+    return size;
+  }
+
+  void Tag::serialize( std::string& out ) const
+  {
+    if( m_name.empty() )
+      return;
+
+    if( !m_xmlCache )
+    {
+      serializeElement( out );
+      return;
+    }
+
+    if( m_xmlCache->empty() )
+    {
+      m_xmlCache->reserve( xmlSize() );
+      serializeElement( *m_xmlCache );
+    }
+    out += *m_xmlCache;
+  }
+
+  void Tag::serializeElement( std::string& out ) const
+  {
+    out += '<';
+    if( !m_prefix.empty() )
+    {
+      out += m_prefix.str();
+      out += ':';
+    }
+    out += m_name.str();
+
+    // shared contents can't change, they were serialized once by share()
+    if( m_shared )
+      out += m_shared->xml;
+    else
+      serializeContents( out );
+
+    if( !content()->m_nodes.empty() )
+    {
+      out += "</";
       if( !m_prefix.empty() )
       {
-        xml += m_prefix;
-        xml += ':';
+        out += m_prefix.str();
+        out += ':';
       }
-      xml += m_name;
-      xml += '>';
+      out += m_name.str();
+      out += '>';
     }
+  }
 
-    return xml;
+  void Tag::serializeContents( std::string& out ) const
+  {
+    const Attribute* const* it_a = m_attribs.begin();
+    for( ; it_a != m_attribs.end(); ++it_a )
+      (*it_a)->appendXml( out );
+
+    if( m_nodes.empty() )
+    {
+      out += "/>";
+      return;
+    }
+
+    out += '>';
+    const Node* it_n = m_nodes.begin();
+    for( ; it_n != m_nodes.end(); ++it_n )
+    {
+      switch( it_n->type )
+      {
+        case TypeTag:
+          it_n->tag->serialize( out );
+          break;
+        case TypeString:
+          util::appendEscaped( out, *(it_n->str) );
+          break;
+      }
+    }
   }
 
   bool Tag::addAttribute( Attribute* attr )
   {
+    detach();
+    invalidateXml();
+
     if( !attr )
       return false;
 
@@ -361,22 +712,25 @@ namespace gloox
       return false;
     }
 
-    if( !m_attribs )
-      m_attribs = new AttributeList();
+    attr->m_parent = this;
 
-    AttributeList::iterator it = m_attribs->begin();
-    for( ; it != m_attribs->end(); ++it )
+    Attribute** it = m_attribs.begin();
+    for( ; it != m_attribs.end(); ++it )
     {
       if( (*it)->name() == attr->name()
           && ( (*it)->xmlns() == attr->xmlns() || (*it)->prefix() == attr->prefix() ) )
       {
+        std::replace( m_attribView->begin(), m_attribView->end(), (*it), attr );
         delete (*it);
         (*it) = attr;
         return true;
       }
     }
 
-    m_attribs->push_back( attr );
+    m_attribs.push_back( attr, m_arena );
+    if( !m_attribView )
+      m_attribView = new AttributeList();
+    m_attribView->push_back( attr );
 
     return true;
   }
@@ -386,7 +740,7 @@ namespace gloox
     if( name.empty() || value.empty() )
       return false;
 
-    return addAttribute( new Attribute( name, value ) );
+    return addAttribute( new( m_arena ) Attribute( name, value ) );
   }
 
   bool Tag::addAttribute( const std::string& name, int value )
@@ -407,32 +761,43 @@ namespace gloox
 
   void Tag::setAttributes( const AttributeList& attributes )
   {
-    if( !m_attribs )
-      m_attribs = new AttributeList( attributes );
-    else
+    detach();
+    invalidateXml();
+
+    Attribute** at = m_attribs.begin();
+    for( ; at != m_attribs.end(); ++at )
+      delete (*at);
+    m_attribs.truncate( 0 );
+
+    AttributeList::const_iterator it = attributes.begin();
+    for( ; it != attributes.end(); ++it )
     {
-      util::clearList( *m_attribs );
-      *m_attribs = attributes;
+      (*it)->m_parent = this;
+      m_attribs.push_back( (*it), m_arena );
     }
 
-    AttributeList::iterator it = m_attribs->begin();
-    for( ; it != m_attribs->end(); ++it )
-      (*it)->m_parent = this;
+    if( !m_attribView )
+      m_attribView = new AttributeList();
+    *m_attribView = attributes;
   }
 
   void Tag::addChild( Tag* child )
   {
+    detach();
+    invalidateXml();
+
     if( !child )
       return;
 
-    if( !m_nodes )
-      m_nodes = new NodeList();
-    if( !m_children )
-      m_children = new TagList();
-
-    m_children->push_back( child );
     child->m_parent = this;
-    m_nodes->push_back( new Node( TypeTag, child ) );
+    m_nodes.push_back( Node( TypeTag, child ), m_arena );
+    if( !m_childView )
+      m_childView = new TagList();
+    m_childView->push_back( child );
+    if( m_childIndex )
+      m_childIndex->add( child );
+    else if( m_childView->size() >= ChildIndexThreshold )
+      buildChildIndex();
   }
 
   void Tag::addChildCopy( const Tag* child )
@@ -440,64 +805,55 @@ namespace gloox
     if( !child )
       return;
 
-    addChild( child->clone() );
+    // taking another reference to shared contents doesn't modify 'child'
+    addChild( child->m_shared ? child->share() : child->clone() );
   }
 
   bool Tag::setCData( const std::string& cdata )
   {
+    detach();
+    invalidateXml();
+
     if( cdata.empty() || !util::checkValidXMLChars( cdata ) )
       return false;
 
-    if( !m_cdata )
-      m_cdata = new StringPList();
-    else
-      util::clearList( *m_cdata );
-
-    if( !m_nodes )
-      m_nodes = new NodeList();
-    else
+    unsigned n = 0;
+    for( unsigned i = 0; i < m_nodes.size(); ++i )
     {
-      NodeList::iterator it = m_nodes->begin();
-      NodeList::iterator t;
-      while( it != m_nodes->end() )
-      {
-        if( (*it)->type == TypeString )
-        {
-          t = it++;
-          delete (*t);
-          m_nodes->erase( t );
-        }
-      }
+      if( m_nodes[i].type == TypeString )
+        delete m_nodes[i].str;
+      else
+        m_nodes[n++] = m_nodes[i];
     }
+    m_nodes.truncate( n );
 
     return addCData( cdata );
   }
 
   bool Tag::addCData( const std::string& cdata )
   {
+    detach();
+    invalidateXml();
+
     if( cdata.empty() || !util::checkValidXMLChars( cdata ) )
       return false;
 
-    if( !m_cdata )
-      m_cdata = new StringPList();
-    if( !m_nodes )
-      m_nodes = new NodeList();
-
-    std::string* str = new std::string( cdata );
-    m_cdata->push_back( str );
-    m_nodes->push_back( new Node( TypeString, str ) );
+    m_nodes.push_back( Node( TypeString, new std::string( cdata ) ), m_arena );
     return true;
   }
 
   const std::string Tag::cdata() const
   {
-    if( !m_cdata )
+    if( m_shared )
+      return m_shared->tag->cdata();
+
+    const Node* it = nextNode( m_nodes.begin(), m_nodes.end(), TypeString );
+    if( it == m_nodes.end() )
       return EmptyString;
 
-    std::string str;
-    StringPList::const_iterator it = m_cdata->begin();
-    for( ; it != m_cdata->end(); ++it )
-      str += *(*it);
+    std::string str( *(it->str) );
+    while( ( it = nextNode( it + 1, m_nodes.end(), TypeString ) ) != m_nodes.end() )
+      str += *(it->str);
 
     return str;
   }
@@ -505,13 +861,15 @@ namespace gloox
   const TagList& Tag::children() const
   {
     static const TagList empty;
-    return m_children ? *m_children : empty;
+    const Tag* c = content();
+    return c->m_childView ? *c->m_childView : empty;
   }
 
   const Tag::AttributeList& Tag::attributes() const
   {
     static const AttributeList empty;
-    return m_attribs ? *m_attribs : empty;
+    const Tag* c = content();
+    return c->m_attribView ? *c->m_attribView : empty;
   }
 
   bool Tag::setXmlns( const std::string& xmlns, const std::string& prefix )
@@ -522,39 +880,38 @@ namespace gloox
     if( prefix.empty() )
     {
       m_xmlns = xmlns;
-      return addAttribute( XMLNS, m_xmlns );
+      return addAttribute( XMLNS, xmlns );
     }
     else
     {
-      if( !m_xmlnss )
-        m_xmlnss = new StringMap();
-
-      (*m_xmlnss)[prefix] = xmlns;
-
+      m_scope = NamespaceScope::push( m_scope, prefix, xmlns );
       return addAttribute( XMLNS + ":" + prefix, xmlns );
     }
   }
 
   const std::string& Tag::xmlns() const
   {
-    return xmlns( m_prefix );
+    return xmlns( m_prefix.str() );
   }
 
   const std::string& Tag::xmlns( const std::string& prefix ) const
   {
     if( prefix.empty() )
     {
-      return hasAttribute( XMLNS ) ? findAttribute( XMLNS ) : m_xmlns;
+      return hasAttribute( XMLNS ) ? findAttribute( XMLNS ) : m_xmlns.str();
     }
 
-    if( m_xmlnss )
+    // Tags created by the Parser share their parent's declarations; each is looked at once only
+    const NamespaceScope* searched = 0;
+    for( const Tag* t = this; t; t = t->m_parent )
     {
-      StringMap::const_iterator it = m_xmlnss->find( prefix );
-      if( it != m_xmlnss->end() )
-        return (*it).second;
+      for( const NamespaceScope* s = t->m_scope; s && s != searched; s = s->parent )
+        if( s->prefix == prefix )
+          return s->xmlns;
+      searched = t->m_scope;
     }
 
-    return m_parent ? m_parent->xmlns( prefix ) : EmptyString;
+    return EmptyString;
   }
 
   bool Tag::setPrefix( const std::string& prefix )
@@ -563,209 +920,457 @@ namespace gloox
       return false;
 
     m_prefix = prefix;
+    invalidateXml();
     return true;
   }
 
   const std::string& Tag::prefix( const std::string& xmlns ) const
   {
-    if( xmlns.empty() || !m_xmlnss )
+    if( xmlns.empty() )
       return EmptyString;
 
-    StringMap::const_iterator it = m_xmlnss->begin();
-    for( ; it != m_xmlnss->end(); ++it )
+    const NamespaceScope* searched = 0;
+    for( const Tag* t = this; t; t = t->m_parent )
     {
-      if( (*it).second == xmlns )
-        return (*it).first;
+      for( const NamespaceScope* s = t->m_scope; s && s != searched; s = s->parent )
+        if( s->xmlns == xmlns && this->xmlns( s->prefix ) == xmlns ) // not re-declared closer
+          return s->prefix;
+      searched = t->m_scope;
     }
 
     return EmptyString;
   }
 
+  const Tag::Attribute* Tag::matchAttribute( const NameRef& name ) const
+  {
+    const Tag* c = content();
+    const Attribute* const* it = c->m_attribs.begin();
+    for( ; it != c->m_attribs.end(); ++it )
+      if( (*it)->m_name.equals( name.atom, name.data, name.length ) )
+        return (*it);
+
+    return 0;
+  }
+
   const std::string& Tag::findAttribute( const std::string& name ) const
   {
-    if( !m_attribs )
+    if( content()->m_attribs.empty() )
       return EmptyString;
 
-    AttributeList::const_iterator it = m_attribs->begin();
-    for( ; it != m_attribs->end(); ++it )
-      if( (*it)->name() == name )
-        return (*it)->value();
+    const Attribute* attr = matchAttribute( name );
+    return attr ? attr->value() : EmptyString;
+  }
 
-    return EmptyString;
+  const std::string& Tag::findAttribute( const char* name ) const
+  {
+    if( content()->m_attribs.empty() )
+      return EmptyString;
+
+    const Attribute* attr = matchAttribute( name );
+    return attr ? attr->value() : EmptyString;
   }
 
   bool Tag::hasAttribute( const std::string& name, const std::string& value ) const
   {
-    if( name.empty() || !m_attribs )
+    if( name.empty() || content()->m_attribs.empty() )
+      return false;
+
+    const Attribute* attr = matchAttribute( name );
+    return attr && ( value.empty() || attr->value() == value );
+  }
+
+  bool Tag::hasAttribute( const char* name, const std::string& value ) const
+  {
+    if( !*name || content()->m_attribs.empty() )
       return false;
 
-    AttributeList::const_iterator it = m_attribs->begin();
-    for( ; it != m_attribs->end(); ++it )
-      if( (*it)->name() == name )
-        return value.empty() || (*it)->value() == value;
+    const Attribute* attr = matchAttribute( name );
+    return attr && ( value.empty() || attr->value() == value );
+  }
 
-    return false;
+  bool Tag::hasAttribute( const char* name, const char* value ) const
+  {
+    if( !*name || content()->m_attribs.empty() )
+      return false;
+
+    const Attribute* attr = matchAttribute( name );
+    return attr && ( !*value || attr->value() == value );
   }
 
   bool Tag::hasChild( const std::string& name, const std::string& attr,
                       const std::string& value ) const
   {
-    if( attr.empty() )
-      return findChild( name ) ? true : false;
-    else
-      return findChild( name, attr, value ) ? true : false;
+    if( content()->m_nodes.empty() || ( name.empty() && !attr.empty() ) )
+      return false;
+
+    return content()->matchChild( name, attr, value ) ? true : false;
+  }
+
+  bool Tag::hasChild( const char* name, const std::string& attr,
+                      const std::string& value ) const
+  {
+    if( content()->m_nodes.empty() || ( !*name && !attr.empty() ) )
+      return false;
+
+    return content()->matchChild( name, attr, value ) ? true : false;
+  }
+
+  void Tag::buildChildIndex()
+  {
+    delete m_childIndex;
+    m_childIndex = 0;
+    if( !m_childView || m_childView->size() < ChildIndexThreshold )
+      return;
+
+    m_childIndex = new ChildIndex();
+    TagList::const_iterator it = m_childView->begin();
+    for( ; it != m_childView->end(); ++it )
+      m_childIndex->add( (*it) );
+  }
+
+  Tag* Tag::matchChild( const NameRef& name, const std::string& attr,
+                        const std::string& value ) const
+  {
+    // an empty 'attr' matches any child of the given name
+    if( m_childIndex )
+    {
+      const std::vector<Tag*>* tags = m_childIndex->find( name );
+      if( !tags )
+        return 0;
+
+      std::vector<Tag*>::const_iterator it = tags->begin();
+      for( ; it != tags->end(); ++it )
+        if( attr.empty() || (*it)->hasAttribute( attr, value ) )
+          return (*it);
+      return 0;
+    }
+
+    const Node* it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+      if( it->type == TypeTag && it->tag->m_name.equals( name.atom, name.data, name.length )
+          && ( attr.empty() || it->tag->hasAttribute( attr, value ) ) )
+        return it->tag;
+    return 0;
   }
 
   Tag* Tag::findChild( const std::string& name ) const
   {
-    if( !m_children )
+    const Tag* c = content();
+    if( c->m_nodes.empty() )
       return 0;
 
-    TagList::const_iterator it = m_children->begin();
-    while( it != m_children->end() && (*it)->name() != name )
-      ++it;
-    return it != m_children->end() ? (*it) : 0;
+    return c->matchChild( name, EmptyString, EmptyString );
+  }
+
+  Tag* Tag::findChild( const char* name ) const
+  {
+    const Tag* c = content();
+    if( c->m_nodes.empty() )
+      return 0;
+
+    return c->matchChild( name, EmptyString, EmptyString );
   }
 
   Tag* Tag::findChild( const std::string& name, const std::string& attr,
                        const std::string& value ) const
   {
-    if( !m_children || name.empty() )
+    const Tag* c = content();
+    if( c->m_nodes.empty() || name.empty() || attr.empty() )
       return 0;
 
-    TagList::const_iterator it = m_children->begin();
-    while( it != m_children->end() && ( (*it)->name() != name || !(*it)->hasAttribute( attr, value ) ) )
-      ++it;
-    return it != m_children->end() ? (*it) : 0;
+    return c->matchChild( name, attr, value );
+  }
+
+  Tag* Tag::findChild( const char* name, const std::string& attr,
+                       const std::string& value ) const
+  {
+    const Tag* c = content();
+    if( c->m_nodes.empty() || !*name || attr.empty() )
+      return 0;
+
+    return c->matchChild( name, attr, value );
   }
 
   bool Tag::hasChildWithCData( const std::string& name, const std::string& cdata ) const
   {
-    if( !m_children || name.empty() || cdata.empty() )
+    if( m_shared )
+      return m_shared->tag->hasChildWithCData( name, cdata );
+
+    if( m_nodes.empty() || name.empty() || cdata.empty() )
       return 0;
 
-    TagList::const_iterator it = m_children->begin();
-    while( it != m_children->end() && ( (*it)->name() != name
-            || ( !cdata.empty() && (*it)->cdata() != cdata ) ) )
-      ++it;
-    return it != m_children->end();
+    const Node* it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+      if( it->type == TypeTag && it->tag->name() == name && it->tag->cdata() == cdata )
+        return true;
+    return false;
   }
 
   Tag* Tag::findChildWithAttrib( const std::string& attr, const std::string& value ) const
   {
-    if( !m_children || attr.empty() )
+    const Tag* c = content();
+    if( c->m_nodes.empty() || attr.empty() )
       return 0;
 
-    TagList::const_iterator it = m_children->begin();
-    while( it != m_children->end() && !(*it)->hasAttribute( attr, value ) )
-      ++it;
-    return it != m_children->end() ? (*it) : 0;
+    const Node* it = c->m_nodes.begin();
+    for( ; it != c->m_nodes.end(); ++it )
+      if( it->type == TypeTag && it->tag->hasAttribute( attr, value ) )
+        return it->tag;
+    return 0;
   }
 
-  Tag* Tag::clone() const
+  Tag* Tag::copyElement() const
   {
-    Tag* t = new Tag( m_name );
+    Tag* t = new Tag( m_name.str() );
     t->m_xmlns = m_xmlns;
     t->m_prefix = m_prefix;
 
-    if( m_attribs )
+    // the copy may be used on another thread than this tree, so it gets its own chain
+    t->m_scope = NamespaceScope::copy( m_scope );
+    return t;
+  }
+
+  Tag* Tag::clone() const
+  {
+    Tag* t = copyElement();
+    t->copyContents( content() );
+    return t;
+  }
+
+  Tag* Tag::cloneShared() const
+  {
+    Tag* holder = new Tag( EmptyString );
+    holder->copyContents( content() );
+
+    Tag* t = copyElement();
+    t->m_shared = new SharedData;
+    t->m_shared->tag = holder;
+    t->m_shared->owner = 0;
+    t->m_shared->refs = 1;
+    holder->serializeContents( t->m_shared->xml );
+    return t;
+  }
+
+  Tag* Tag::share() const
+  {
+    if( m_arena )
+      return clone();
+
+    if( !m_shared )
     {
-      t->m_attribs = new AttributeList();
-      Tag::AttributeList::const_iterator at = m_attribs->begin();
-      Attribute* attr;
-      for( ; at != m_attribs->end(); ++at )
-      {
-        attr = new Attribute( *(*at) );
-        attr->m_parent = t;
-        t->m_attribs->push_back( attr );
-      }
+      // moving the contents into a holder doesn't change this Tag's observable state: the
+      // children still report this Tag as their parent
+      Tag* self = const_cast<Tag*>( this );
+      Tag* holder = new Tag( EmptyString );
+      holder->takeContents( self );
+      holder->setContentParent( self );
+      m_shared = new SharedData;
+      m_shared->tag = holder;
+      m_shared->owner = this;
+      m_shared->refs = 1;
+      holder->serializeContents( m_shared->xml );
+    }
+
+    Tag* t = copyElement();
+    SharedData::addRefs( m_shared, 1 );
+    t->m_shared = m_shared;
+    return t;
+  }
+
+  void Tag::unshare() const
+  {
+    // a Tag's contents are logically part of it even when shared
+    Tag* self = const_cast<Tag*>( this );
+    SharedData* shared = m_shared;
+    m_shared = 0;
+
+    // with the last reference, nobody else can get hold of the contents anymore
+    if( SharedData::addRefs( shared, 0 ) == 1 )
+    {
+      self->takeContents( shared->tag );
+      delete shared->tag;
+      delete shared;
+      return;
+    }
+
+    if( shared->owner == this )
+    {
+      // the Tag share() was called on takes its children back, so that pointers to them
+      // stay valid; the others keep sharing a copy
+      Tag* holder = new Tag( EmptyString );
+      holder->copyContents( shared->tag );
+      self->takeContents( shared->tag );
+      delete shared->tag;
+      shared->tag = holder;
+      shared->owner = 0;
+    }
+    else
+      self->copyContents( shared->tag );
+
+    // only now, another Tag releasing its reference meanwhile may delete the contents
+    SharedData::release( shared );
+  }
+
+  void Tag::releaseShared() const
+  {
+    SharedData* shared = m_shared;
+    m_shared = 0;
+
+    if( shared->owner == this )
+    {
+      shared->tag->setContentParent( shared->tag );
+      shared->owner = 0;
     }
+    SharedData::release( shared );
+  }
+
+  void Tag::takeContents( Tag* from )
+  {
+    m_nodes.steal( from->m_nodes );
+    m_attribs.steal( from->m_attribs );
+    m_childView = from->m_childView;
+    m_attribView = from->m_attribView;
+    m_childIndex = from->m_childIndex;
+    from->m_childView = 0;
+    from->m_attribView = 0;
+    from->m_childIndex = 0;
+
+    setContentParent( this );
+  }
+
+  void Tag::setContentParent( Tag* parent )
+  {
+    Attribute** at = m_attribs.begin();
+    for( ; at != m_attribs.end(); ++at )
+      (*at)->m_parent = parent;
 
-    if( m_xmlnss )
+    Node* it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+      if( it->type == TypeTag )
+        it->tag->m_parent = parent;
+  }
+
+  void Tag::copyContents( const Tag* from )
+  {
+    const Attribute* const* at = from->m_attribs.begin();
+    for( ; at != from->m_attribs.end(); ++at )
     {
-      t->m_xmlnss = new StringMap( *m_xmlnss );
+      Attribute* attr = new Attribute( *(*at) );
+      attr->m_parent = this;
+      m_attribs.push_back( attr, m_arena );
+      if( !m_attribView )
+        m_attribView = new AttributeList();
+      m_attribView->push_back( attr );
     }
 
-    if( m_nodes )
+    const Node* nt = from->m_nodes.begin();
+    for( ; nt != from->m_nodes.end(); ++nt )
     {
-      Tag::NodeList::const_iterator nt = m_nodes->begin();
-      for( ; nt != m_nodes->end(); ++nt )
+      switch( nt->type )
       {
-        switch( (*nt)->type )
-        {
-          case TypeTag:
-            t->addChild( (*nt)->tag->clone() );
-            break;
-          case TypeString:
-            t->addCData( *((*nt)->str) );
-            break;
-        }
+        case TypeTag:
+          addChild( nt->tag->clone() );
+          break;
+        case TypeString:
+          addCData( *(nt->str) );
+          break;
       }
     }
-
-    return t;
   }
 
   TagList Tag::findChildren( const std::string& name,
                              const std::string& xmlns ) const
   {
-    return m_children ? findChildren( *m_children, name, xmlns ) : TagList();
+    const Tag* c = content();
+    if( c->m_nodes.empty() )
+      return TagList();
+
+    return c->matchChildren( name, xmlns );
   }
 
-  TagList Tag::findChildren( const TagList& list, const std::string& name,
-                             const std::string& xmlns ) const
+  TagList Tag::findChildren( const char* name, const std::string& xmlns ) const
+  {
+    const Tag* c = content();
+    if( c->m_nodes.empty() )
+      return TagList();
+
+    return c->matchChildren( name, xmlns );
+  }
+
+  TagList Tag::matchChildren( const NameRef& name, const std::string& xmlns ) const
   {
     TagList ret;
-    TagList::const_iterator it = list.begin();
-    for( ; it != list.end(); ++it )
+    if( m_childIndex )
+    {
+      const std::vector<Tag*>* tags = m_childIndex->find( name );
+      if( !tags )
+        return ret;
+
+      std::vector<Tag*>::const_iterator it = tags->begin();
+      for( ; it != tags->end(); ++it )
+        if( xmlns.empty() || (*it)->xmlns() == xmlns )
+          ret.push_back( (*it) );
+      return ret;
+    }
+
+    const Node* it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
     {
-      if( (*it)->name() == name && ( xmlns.empty() || (*it)->xmlns() == xmlns ) )
-        ret.push_back( (*it) );
+      if( it->type == TypeTag && it->tag->m_name.equals( name.atom, name.data, name.length )
+          && ( xmlns.empty() || it->tag->xmlns() == xmlns ) )
+        ret.push_back( it->tag );
     }
     return ret;
   }
 
   void Tag::removeChild( const std::string& name, const std::string& xmlns )
   {
-    if( name.empty() || !m_children || !m_nodes )
+    detach();
+    invalidateXml();
+
+    if( name.empty() || m_nodes.empty() )
       return;
 
-    TagList l = findChildren( name, xmlns );
-    TagList::iterator it = l.begin();
-    TagList::iterator it2;
-    while( it != l.end() )
+    const std::string* atom = Atom::find( name );
+    unsigned n = 0;
+    for( unsigned i = 0; i < m_nodes.size(); ++i )
     {
-      it2 = it++;
-      NodeList::iterator itn = m_nodes->begin();
-      for( ; itn != m_nodes->end(); ++itn )
+      Tag* child = m_nodes[i].type == TypeTag ? m_nodes[i].tag : 0;
+      if( child && child->m_name.equals( atom, name )
+          && ( xmlns.empty() || child->xmlns() == xmlns ) )
       {
-        if( (*itn)->type == TypeTag && (*itn)->tag == (*it2) )
-        {
-          delete (*itn);
-          m_nodes->erase( itn );
-          break;
-        }
+        if( m_childView )
+          m_childView->remove( child );
+        delete child;
       }
-      m_children->remove( (*it2) );
-      delete (*it2);
+      else
+        m_nodes[n++] = m_nodes[i];
+    }
+
+    if( n < m_nodes.size() )
+    {
+      m_nodes.truncate( n );
+      // cheaper to rebuild than to update for every removed child
+      buildChildIndex();
     }
   }
 
   void Tag::removeChild( Tag* tag )
   {
-    if( m_children )
-      m_children->remove( tag );
+    detach();
+    invalidateXml();
 
-    if( !m_nodes )
-      return;
+    if( m_childView )
+      m_childView->remove( tag );
+    if( m_childIndex )
+      m_childIndex->remove( tag );
 
-    NodeList::iterator it = m_nodes->begin();
-    for( ; it != m_nodes->end(); ++it )
+    for( unsigned i = 0; i < m_nodes.size(); ++i )
     {
-      if( (*it)->type == TypeTag && (*it)->tag == tag )
+      if( m_nodes[i].type == TypeTag && m_nodes[i].tag == tag )
       {
-        delete (*it);
-        m_nodes->erase( it );
+        m_nodes.erase( i );
+        tag->m_parent = 0;
         return;
       }
     }
@@ -774,21 +1379,27 @@ namespace gloox
   void Tag::removeAttribute( const std::string& attr, const std::string& value,
                              const std::string& xmlns )
   {
-    if( attr.empty() || !m_attribs )
+    detach();
+    invalidateXml();
+
+    if( attr.empty() || m_attribs.empty() )
       return;
 
-    AttributeList::iterator it = m_attribs->begin();
-    AttributeList::iterator it2;
-    while( it != m_attribs->end() )
+    unsigned n = 0;
+    for( unsigned i = 0; i < m_attribs.size(); ++i )
     {
-      it2 = it++;
-      if( (*it2)->name() == attr && ( value.empty() || (*it2)->value() == value )
-                                 && ( xmlns.empty() || (*it2)->xmlns() == xmlns ) )
+      Attribute* a = m_attribs[i];
+      if( a->name() == attr && ( value.empty() || a->value() == value )
+                            && ( xmlns.empty() || a->xmlns() == xmlns ) )
       {
-        delete (*it2);
-        m_attribs->erase( it2 );
+        if( m_attribView )
+          m_attribView->remove( a );
+        delete a;
       }
+      else
+        m_attribs[n++] = a;
     }
+    m_attribs.truncate( n );
   }
 
   const std::string Tag::findCData( const std::string& expression ) const
@@ -805,34 +1416,60 @@ namespace gloox
 
   ConstTagList Tag::findTagList( const std::string& expression ) const
   {
-    ConstTagList l;
-    if( expression == "/" || expression == "//" )
-      return l;
+    const CompiledXPath* xpath = CompiledXPath::cached( expression );
+    if( xpath )
+      return findTagList( *xpath );
 
-    if( m_parent && expression.length() >= 2 && expression[0] == '/'
-                                             && expression[1] != '/' )
-      return m_parent->findTagList( expression );
+    const CompiledXPath xp( expression );
+    return findTagList( xp );
+  }
 
-    unsigned len = 0;
-    Tag* p = parse( expression, len );
-//     if( p )
-//       printf( "parsed tree: %s\n", p->xml().c_str() );
-    l = evaluateTagList( p );
-    delete p;
-    return l;
+  const std::string Tag::findCData( const CompiledXPath& xpath ) const
+  {
+    const ConstTagList& l = findTagList( xpath );
+    return !l.empty() ? l.front()->cdata() : EmptyString;
   }
 
-  ConstTagList Tag::evaluateTagList( Tag* token ) const
+  const Tag* Tag::findTag( const CompiledXPath& xpath ) const
+  {
+    const ConstTagList& l = findTagList( xpath );
+    return !l.empty() ? l.front() : 0;
+  }
+
+  ConstTagList Tag::findTagList( const CompiledXPath& xpath ) const
+  {
+    if( !xpath.m_root )
+      return ConstTagList();
+
+    if( m_parent && xpath.m_absolute )
+      return m_parent->findTagList( xpath );
+
+//     printf( "parsed tree: %s\n", xpath.m_root->xml().c_str() );
+    return evaluateTagList( xpath.m_root );
+  }
+
+  Tag::TokenType Tag::tokenType( const Tag* token )
+  {
+    return (TokenType)atoi( token->findAttribute( TYPE ).c_str() );
+  }
+
+  ConstTagList Tag::evaluateTagList( const Tag* token ) const
   {
-    ConstTagList result;
     if( !token )
-      return result;
+      return ConstTagList();
+
+    return evaluateTagList( token, tokenType( token ) );
+  }
+
+  ConstTagList Tag::evaluateTagList( const Tag* token, TokenType type ) const
+  {
+    const Tag* c = content();
+    ConstTagList result;
 
 //     printf( "evaluateTagList called in Tag %s and Token %s (type: %s)\n", name().c_str(),
 //             token->name().c_str(), token->findAttribute( TYPE ).c_str() );
 
-    TokenType tokenType = (TokenType)atoi( token->findAttribute( TYPE ).c_str() );
-    switch( tokenType )
+    switch( type )
     {
       case XTUnion:
         add( result, evaluateUnion( token ) );
@@ -869,18 +1506,18 @@ namespace gloox
               hasElementChildren = true;
 
 //               printf( "checking %d children of token %s\n", tokenChildren.size(), token->name().c_str() );
-              if( m_children && !m_children->empty() )
+              if( nextNode( c->m_nodes.begin(), c->m_nodes.end(), TypeTag ) != c->m_nodes.end() )
               {
-                TagList::const_iterator it = m_children->begin();
-                for( ; it != m_children->end(); ++it )
+                const Node* it = c->m_nodes.begin();
+                for( ; it != c->m_nodes.end(); ++it )
                 {
-                  add( result, (*it)->evaluateTagList( (*cit) ) );
+                  if( it->type == TypeTag )
+                    add( result, it->tag->evaluateTagList( (*cit) ) );
                 }
               }
-              else if( atoi( (*cit)->findAttribute( TYPE ).c_str() ) == XTDoubleDot && m_parent )
+              else if( tokenType( (*cit) ) == XTDoubleDot && m_parent )
               {
-                (*cit)->addAttribute( TYPE, XTDot );
-                add( result, m_parent->evaluateTagList( (*cit) ) );
+                add( result, m_parent->evaluateTagList( (*cit), XTDot ) );
               }
             }
 
@@ -901,17 +1538,13 @@ namespace gloox
       case XTDoubleSlash:
       {
 //         printf( "in XTDoubleSlash\n" );
-        Tag* t = token->clone();
-//         printf( "original token: %s\ncloned token: %s\n", token->xml().c_str(), n->xml().c_str() );
-        t->addAttribute( TYPE, XTElement );
-        add( result, evaluateTagList( t ) );
+        add( result, evaluateTagList( token, XTElement ) );
         const ConstTagList& res2 = allDescendants();
         ConstTagList::const_iterator it = res2.begin();
         for( ; it != res2.end(); ++it )
         {
-          add( result, (*it)->evaluateTagList( t ) );
+          add( result, (*it)->evaluateTagList( token, XTElement ) );
         }
-        delete t;
         break;
       }
       case XTDot:
@@ -980,17 +1613,16 @@ namespace gloox
     return result;
   }
 
-  bool Tag::evaluateBoolean( Tag* token ) const
+  bool Tag::evaluateBoolean( const Tag* token ) const
   {
     if( !token )
       return false;
 
     bool result = false;
-    TokenType tokenType = (TokenType)atoi( token->findAttribute( TYPE ).c_str() );
-    switch( tokenType )
+    switch( tokenType( token ) )
     {
       case XTAttribute:
-        if( token->name() == "*" && m_attribs && m_attribs->size() )
+        if( token->name() == "*" && !content()->m_attribs.empty() )
           result = true;
         else
           result = hasAttribute( token->name() );
@@ -1008,15 +1640,8 @@ namespace gloox
         break;
       case XTUnion:
       case XTElement:
-      {
-        Tag* t = new Tag( "." );
-        t->addAttribute( TYPE, XTDot );
-        t->addChild( token );
-        result = !evaluateTagList( t ).empty();
-        t->removeChild( token );
-        delete t;
+        result = !evaluateTagList( token ).empty();
         break;
-      }
       default:
         break;
     }
@@ -1024,7 +1649,7 @@ namespace gloox
     return result;
   }
 
-  bool Tag::evaluateEquals( Tag* token ) const
+  bool Tag::evaluateEquals( const Tag* token ) const
   {
     if( !token || token->children().size() != 2 )
       return false;
@@ -1034,8 +1659,8 @@ namespace gloox
     Tag* ch1 = (*it);
     Tag* ch2 = (*++it);
 
-    TokenType tt1 = (TokenType)atoi( ch1->findAttribute( TYPE ).c_str() );
-    TokenType tt2 = (TokenType)atoi( ch2->findAttribute( TYPE ).c_str() );
+    TokenType tt1 = tokenType( ch1 );
+    TokenType tt2 = tokenType( ch2 );
     switch( tt1 )
     {
       case XTAttribute:
@@ -1077,21 +1702,22 @@ namespace gloox
 
   ConstTagList Tag::allDescendants() const
   {
+    const Tag* c = content();
     ConstTagList result;
 
-    if( !m_children )
-      return result;
-
-    TagList::const_iterator it = m_children->begin();
-    for( ; it != m_children->end(); ++it )
+    const Node* it = c->m_nodes.begin();
+    for( ; it != c->m_nodes.end(); ++it )
     {
-      result.push_back( (*it) );
-      add( result, (*it)->allDescendants() );
+      if( it->type != TypeTag )
+        continue;
+
+      result.push_back( it->tag );
+      add( result, it->tag->allDescendants() );
     }
     return result;
   }
 
-  ConstTagList Tag::evaluateUnion( Tag* token ) const
+  ConstTagList Tag::evaluateUnion( const Tag* token ) const
   {
     ConstTagList result;
     if( !token )
@@ -1106,7 +1732,7 @@ namespace gloox
     return result;
   }
 
-  void Tag::closePreviousToken( Tag** root, Tag** current, Tag::TokenType& type, std::string& tok ) const
+  void Tag::closePreviousToken( Tag** root, Tag** current, Tag::TokenType& type, std::string& tok )
   {
     if( !tok.empty() )
     {
@@ -1116,7 +1742,7 @@ namespace gloox
     }
   }
 
-  Tag* Tag::parse( const std::string& expression, unsigned& len, Tag::TokenType border ) const
+  Tag* Tag::parse( const std::string& expression, unsigned& len, Tag::TokenType border )
   {
     Tag* root = 0;
     Tag* current = root;
@@ -1258,7 +1884,7 @@ namespace gloox
   }
 
   void Tag::addToken( Tag **root, Tag **current, Tag::TokenType type,
-                      const std::string& token ) const
+                      const std::string& token )
   {
     Tag* t = new Tag( token );
     if( t->isNumber() && !t->children().size() )
@@ -1279,7 +1905,7 @@ namespace gloox
   }
 
   void Tag::addOperator( Tag** root, Tag** current, Tag* arg,
-                           Tag::TokenType type, const std::string& token ) const
+                           Tag::TokenType type, const std::string& token )
   {
     Tag* t = new Tag( token );
     t->addAttribute( TYPE, type );
@@ -1291,7 +1917,7 @@ namespace gloox
     *current = *root = t;
   }
 
-  bool Tag::addPredicate( Tag **root, Tag **current, Tag* token ) const
+  bool Tag::addPredicate( Tag **root, Tag **current, Tag* token )
   {
     if( !*root || !*current )
       return false;
@@ -1354,9 +1980,10 @@ namespace gloox
     if( m_name.empty() )
       return false;
 
-    std::string::size_type l = m_name.length();
+    const std::string& name = m_name.str();
+    std::string::size_type l = name.length();
     std::string::size_type i = 0;
-    while( i < l && isdigit( m_name[i] ) )
+    while( i < l && isdigit( name[i] ) )
       ++i;
     return i == l;
   }
@@ -15,15 +15,19 @@
 #define TAG_H__
 
 #include "gloox.h"
+#include "atom.h"
 
 #include <string>
 #include <list>
 #include <utility>
+#include <cstddef>
 
 namespace gloox
 {
 
   class Tag;
+  class TagArena;
+  class CompiledXPath;
 
   /**
    * A list of Tags.
@@ -40,6 +44,10 @@ namespace gloox
    *
    * @note Use setXmlns() to set namespaces and namespace prefixes.
    *
+   * @note const functions don't modify a Tag, so several threads can read a tree at the same
+   * time as long as none modifies it. Exceptions are serializing a Tag that has
+   * setXmlCaching() enabled, and share().
+   *
    * @author Jakob Schroeter <js@camaya.net>
    * @since 0.4
    */
@@ -47,6 +55,7 @@ namespace gloox
   {
 
     friend class Parser;
+    friend class CompiledXPath;
 
     public:
 
@@ -97,11 +106,38 @@ namespace gloox
            */
           virtual ~Attribute() {}
 
+          /**
+           * Allocates an Attribute on the heap.
+           * @param size The number of bytes to allocate.
+           */
+          static void* operator new( std::size_t size );
+
+          /**
+           * Allocates an Attribute in the given TagArena, or on the heap if @c arena is 0.
+           * @param size The number of bytes to allocate.
+           * @param arena The arena to allocate from.
+           * @since 1.0
+           */
+          static void* operator new( std::size_t size, TagArena* arena );
+
+          /**
+           * Frees an Attribute's memory, unless it lives in a TagArena.
+           * @param p The memory to free.
+           */
+          static void operator delete( void* p );
+
+          /**
+           * Frees an Attribute's memory, unless it lives in a TagArena.
+           * @param p The memory to free.
+           * @param arena The arena the memory was allocated from.
+           */
+          static void operator delete( void* p, TagArena* arena );
+
           /**
            * Returns the attribute's name.
            * @return The attribute's name.
            */
-          const std::string& name() const { return m_name; }
+          const std::string& name() const { return m_name.str(); }
 
           /**
            * Returns the attribute's value.
@@ -151,6 +187,14 @@ namespace gloox
            */
           const std::string xml() const;
 
+          /**
+           * Appends the attribute's string representation (as returned by xml()) to the given
+           * string.
+           * @param out The string to append to.
+           * @since 1.0
+           */
+          void appendXml( std::string& out ) const;
+
           /**
            * Checks two Attributes for equality.
            * @param right The Attribute to check against the current Attribute.
@@ -174,10 +218,10 @@ namespace gloox
           void init( const std::string& name, const std::string& value,
                      const std::string& xmlns );
           Tag* m_parent;
-          std::string m_name;
+          Atom m_name;
           std::string m_value;
-          std::string m_xmlns;
-          std::string m_prefix;
+          Atom m_xmlns;
+          Atom m_prefix;
 
       };
 
@@ -225,6 +269,35 @@ namespace gloox
        */
       virtual ~Tag();
 
+      /**
+       * Allocates a Tag on the heap.
+       * @param size The number of bytes to allocate.
+       */
+      static void* operator new( std::size_t size );
+
+      /**
+       * Allocates a Tag in the given TagArena, or on the heap if @c arena is 0.
+       * @param size The number of bytes to allocate.
+       * @param arena The arena to allocate from.
+       * @note A Tag living in an arena is freed when the arena is reset. Use clone() to
+       * get an independent, heap-allocated copy.
+       * @since 1.0
+       */
+      static void* operator new( std::size_t size, TagArena* arena );
+
+      /**
+       * Frees a Tag's memory, unless it lives in a TagArena.
+       * @param p The memory to free.
+       */
+      static void operator delete( void* p );
+
+      /**
+       * Frees a Tag's memory, unless it lives in a TagArena.
+       * @param p The memory to free.
+       * @param arena The arena the memory was allocated from.
+       */
+      static void operator delete( void* p, TagArena* arena );
+
       /**
        * This function can be used to retrieve the complete XML of a tag as a string.
        * It includes all the attributes, child nodes and character data.
@@ -232,6 +305,27 @@ namespace gloox
        */
       const std::string xml() const;
 
+      /**
+       * Appends the complete XML of the Tag (as returned by xml()) to the given string. Unlike
+       * xml(), this doesn't create any temporary strings. It is meant to be used with a
+       * buffer that is re-used, so that serializing a Tag does not need to allocate memory
+       * once the buffer is large enough.
+       * @param out The string to append to.
+       * @since 1.0
+       */
+      void appendXml( std::string& out ) const;
+
+      /**
+       * Switches caching of the Tag's serialized form on/off. Default: off.
+       * If switched on, the XML generated by xml() or appendXml() (of this Tag or of any of its
+       * ancestors) is kept and re-used until this Tag or one of its descendants is modified.
+       * This makes re-sending an unchanged Tag, e.g. a presence broadcast, a plain copy.
+       * @note Changes made through Tag's and Attribute's functions are tracked automatically.
+       * @param cache Whether to switch caching on or off.
+       * @since 1.0
+       */
+      void setXmlCaching( bool cache );
+
       /**
        * Sets the Tag's namespace prefix.
        * @param prefix The namespace prefix.
@@ -246,7 +340,7 @@ namespace gloox
        * @return The namespace prefix.
        * @since 1.0
        */
-      const std::string& prefix() const { return m_prefix; }
+      const std::string& prefix() const { return m_prefix.str(); }
 
       /**
        * Returns the namespace prefix for the given namespace.
@@ -365,7 +459,8 @@ namespace gloox
       void addChild( Tag* child );
 
       /**
-       * Use this function to add a copy of the given element to the tag.
+       * Use this function to add a copy of the given element to the tag. If @p child shares
+       * its contents with other Tags (see share()), the copy shares them, too.
        * @param child The node to be inserted.
        * @since 0.9
        */
@@ -391,7 +486,7 @@ namespace gloox
        * Use this function to retrieve the name of an element.
        * @return The name of the tag.
        */
-      const std::string& name() const { return m_name; }
+      const std::string& name() const { return m_name.str(); }
 
       /**
        * Use this function to retrieve the XML character data of an element.
@@ -401,12 +496,18 @@ namespace gloox
 
       /**
        * Use this function to fetch a const list of attributes.
+       * @note Attributes are stored in a compact array internally. The list is built on first
+       * use and kept up to date from then on. Prefer findAttribute() and hasAttribute() where
+       * possible.
        * @return A constant reference to the list of attributes.
        */
       const AttributeList& attributes() const;
 
       /**
        * Use this function to fetch a const list of child elements.
+       * @note Child elements are stored in a compact array internally. The list is kept up
+       * to date as children are added and removed. Prefer findChild() and findChildren()
+       * where possible.
        * @return A constant reference to the list of child elements.
        */
       const TagList& children() const;
@@ -418,6 +519,15 @@ namespace gloox
        */
       const std::string& findAttribute( const std::string& name ) const;
 
+      /**
+       * Same as findAttribute( const std::string& ), but takes the name as a C string.
+       * Calls with a string literal use this overload and don't create a temporary std::string.
+       * @param name The name of the attribute to look for.
+       * @return The value of the attribute if found, an empty string otherwise.
+       * @since 1.0
+       */
+      const std::string& findAttribute( const char* name ) const;
+
       /**
        * Checks whether the tag has a attribute with given name and optional value.
        * @param name The name of the attribute to check for.
@@ -426,6 +536,26 @@ namespace gloox
        */
       bool hasAttribute( const std::string& name, const std::string& value = EmptyString ) const;
 
+      /**
+       * Same as hasAttribute( const std::string&, const std::string& ), but takes the
+       * name as a C string.
+       * @param name The name of the attribute to check for.
+       * @param value The value of the attribute to check for.
+       * @return Whether the attribute exists (optionally with the given value).
+       * @since 1.0
+       */
+      bool hasAttribute( const char* name, const std::string& value = EmptyString ) const;
+
+      /**
+       * Same as hasAttribute( const std::string&, const std::string& ), but takes the
+       * name and value as C strings.
+       * @param name The name of the attribute to check for.
+       * @param value The value of the attribute to check for.
+       * @return Whether the attribute exists with the given value.
+       * @since 1.0
+       */
+      bool hasAttribute( const char* name, const char* value ) const;
+
       /**
        * This function finds and returns the @b first element within the child elements of the current tag
        * that has a matching tag name.
@@ -434,6 +564,14 @@ namespace gloox
        */
       Tag* findChild( const std::string& name ) const;
 
+      /**
+       * Same as findChild( const std::string& ), but takes the name as a C string.
+       * @param name The name of the element to search for.
+       * @return The found Tag, or 0.
+       * @since 1.0
+       */
+      Tag* findChild( const char* name ) const;
+
       /**
        * This function finds and returns the @b first element within the child elements of the current tag,
        * that has a certain name, and a certain attribute with a certain value.
@@ -445,6 +583,18 @@ namespace gloox
       Tag* findChild( const std::string& name, const std::string& attr,
                       const std::string& value = EmptyString ) const;
 
+      /**
+       * Same as findChild( const std::string&, const std::string&, const std::string& ), but
+       * takes the element name as a C string.
+       * @param name The name of the element to search for.
+       * @param attr The name of the attribute of the child element.
+       * @param value The value of the attribute of the child element.
+       * @return The found Tag, or 0.
+       * @since 1.0
+       */
+      Tag* findChild( const char* name, const std::string& attr,
+                      const std::string& value = EmptyString ) const;
+
       /**
        * This function checks whether the Tag has a child element with a given name, and optionally
        * this child element is checked for having a given attribute with an optional value.
@@ -456,6 +606,18 @@ namespace gloox
       bool hasChild( const std::string& name, const std::string& attr = EmptyString,
                      const std::string& value = EmptyString ) const;
 
+      /**
+       * Same as hasChild( const std::string&, const std::string&, const std::string& ), but
+       * takes the element name as a C string.
+       * @param name The name of the child element.
+       * @param attr The name of the attribute of the child element.
+       * @param value The value of the attribute of the child element.
+       * @return @b True if the given child element exists, @b false otherwise.
+       * @since 1.0
+       */
+      bool hasChild( const char* name, const std::string& attr = EmptyString,
+                     const std::string& value = EmptyString ) const;
+
       /**
        * This function checks whether the Tag has a child element which posesses a given attribute
        * with an optional value. The name of the child element does not matter.
@@ -486,6 +648,16 @@ namespace gloox
        */
       TagList findChildren( const std::string& name, const std::string& xmlns = EmptyString ) const;
 
+      /**
+       * Same as findChildren( const std::string&, const std::string& ), but takes the
+       * name as a C string.
+       * @param name The name of the tags to look for.
+       * @param xmlns An optional namespace to check for.
+       * @return A list of tags with the given name.
+       * @since 1.0
+       */
+      TagList findChildren( const char* name, const std::string& xmlns = EmptyString ) const;
+
       /**
        * Removes and deletes all child tags that have the given name and are, optionally,
        * within the given namespace.
@@ -497,7 +669,7 @@ namespace gloox
       /**
        * Removes the given Tag from the list of child Tags.
        * @param tag The Tag to remove from the list of child Tags.
-       * @note The Tag @p tag is not deleted.
+       * @note The Tag @p tag is not deleted. Its parent is reset to 0.
        */
       void removeChild( Tag* tag );
 
@@ -526,12 +698,46 @@ namespace gloox
       Tag* parent() const { return m_parent; }
 
       /**
-       * This function creates a deep copy of this Tag.
+       * This function creates a deep copy of this Tag. Use share() to get a copy that
+       * shares this Tag's contents instead.
        * @return An independent copy of the Tag.
        * @since 0.7
        */
       Tag* clone() const;
 
+      /**
+       * Creates a deep copy of this Tag, like clone(), whose contents are ready to be shared:
+       * share() called on the returned Tag doesn't modify it and only takes a reference.
+       * Use this for payloads that get shared later on, possibly from several threads.
+       * @return A copy of the Tag. You are responsible for deleting it.
+       * @since 1.0
+       */
+      Tag* cloneShared() const;
+
+      /**
+       * Creates a copy of this Tag that shares attributes, character data and child elements
+       * with this Tag instead of copying them. A Tag gets a private copy of shared contents
+       * only once it is modified, e.g. through addChild() or addAttribute() (copy-on-write).
+       * Serializing, comparing and all lookups work on the shared contents: child elements
+       * returned by children(), findChild() etc. are shared, too, and must not be modified.
+       *
+       * Use this to pass the same payload to many handlers or to send it to many recipients,
+       * e.g. a pubsub item, without copying it for each of them.
+       * @note Child elements and attributes obtained from this Tag before calling share() stay
+       * valid and keep reporting this Tag as their parent, but must not be modified while the
+       * contents are shared.
+       * @note The first call to share() on a Tag moves its contents into shared storage, so it
+       * must not run concurrently with other uses of the Tag. Once the contents are shared
+       * (and for Tags created by cloneShared()), share() only increments a reference count
+       * atomically. The Tags it returns can then be used, modified and deleted from different
+       * threads. The Tag share() was first called on keeps its own children, so it must not be
+       * modified or deleted while others use the shared contents. For Tags allocated from a
+       * TagArena, this function falls back to clone().
+       * @return A new Tag sharing this Tag's contents. You are responsible for deleting it.
+       * @since 1.0
+       */
+      Tag* share() const;
+
       /**
        * Evaluates the given XPath expression and returns the result Tag's character data, if any.
        * If more than one Tag match, only the first one's character data is returned.
@@ -567,6 +773,31 @@ namespace gloox
        */
       ConstTagList findTagList( const std::string& expression ) const;
 
+      /**
+       * Evaluates the given pre-parsed XPath expression and returns the first matched Tag's
+       * character data, if any.
+       * @param xpath A compiled XPath expression to evaluate.
+       * @return A matched Tag's character data, or the empty string.
+       * @since 1.0
+       */
+      const std::string findCData( const CompiledXPath& xpath ) const;
+
+      /**
+       * Evaluates the given pre-parsed XPath expression and returns the first matched Tag.
+       * @param xpath A compiled XPath expression to evaluate.
+       * @return A matched Tag, or 0.
+       * @since 1.0
+       */
+      const Tag* findTag( const CompiledXPath& xpath ) const;
+
+      /**
+       * Evaluates the given pre-parsed XPath expression and returns the matched Tags.
+       * @param xpath A compiled XPath expression to evaluate.
+       * @return A list of matched Tags, or an empty TagList.
+       * @since 1.0
+       */
+      ConstTagList findTagList( const CompiledXPath& xpath ) const;
+
       /**
        * Checks two Tags for equality. Order of attributes and child tags does matter.
        * @param right The Tag to check against the current Tag.
@@ -612,9 +843,9 @@ namespace gloox
 
       struct Node
       {
+        Node() : type( TypeTag ), tag( 0 ) {}
         Node( NodeType _type, Tag* _tag ) : type( _type ), tag( _tag ) {}
         Node( NodeType _type, std::string* _str ) : type( _type ), str( _str ) {}
-        ~Node() {}
 
         NodeType type;
         union
@@ -624,17 +855,157 @@ namespace gloox
         };
       };
 
-      typedef std::list<Node*> NodeList;
+      static void* allocateStorage( std::size_t size, TagArena* arena );
+      static void freeStorage( void* p );
+
+      /**
+       * A contiguous array that keeps up to N elements inside the owning Tag and moves
+       * them to storage allocated from the Tag's arena (or the heap) once it outgrows that.
+       * Only suitable for types that can be copied bytewise.
+       */
+      template<typename T, unsigned N>
+      class InlineArray
+      {
+        public:
+          InlineArray() : m_data( m_inline ), m_size( 0 ), m_capacity( N ) {}
+          ~InlineArray() { release(); }
+
+          T* begin() const { return m_data; }
+          T* end() const { return m_data + m_size; }
+          unsigned size() const { return m_size; }
+          bool empty() const { return m_size == 0; }
+          T& operator[]( unsigned i ) const { return m_data[i]; }
+
+          void push_back( const T& t, TagArena* arena )
+          {
+            if( m_size == m_capacity )
+              grow( arena );
+            m_data[m_size++] = t;
+          }
+
+          void erase( unsigned i )
+          {
+            for( --m_size; i < m_size; ++i )
+              m_data[i] = m_data[i+1];
+          }
+
+          void truncate( unsigned size ) { m_size = size; }
+
+          void steal( InlineArray& other )
+          {
+            release();
+            if( other.m_data == other.m_inline )
+            {
+              for( unsigned i = 0; i < other.m_size; ++i )
+                m_inline[i] = other.m_inline[i];
+            }
+            else
+            {
+              m_data = other.m_data;
+              m_capacity = other.m_capacity;
+              other.m_data = other.m_inline;
+              other.m_capacity = N;
+            }
+            m_size = other.m_size;
+            other.m_size = 0;
+          }
+
+        private:
+          InlineArray( const InlineArray& );
+          InlineArray& operator=( const InlineArray& );
+
+          void release()
+          {
+            if( m_data != m_inline )
+              Tag::freeStorage( m_data );
+            m_data = m_inline;
+            m_capacity = N;
+          }
+
+          void grow( TagArena* arena )
+          {
+            const unsigned capacity = m_capacity * 2;
+            T* data = static_cast<T*>( Tag::allocateStorage( capacity * sizeof( T ), arena ) );
+            for( unsigned i = 0; i < m_size; ++i )
+              data[i] = m_data[i];
+            if( m_data != m_inline )
+              Tag::freeStorage( m_data );
+            m_data = data;
+            m_capacity = capacity;
+          }
+
+          T m_inline[N];
+          T* m_data;
+          unsigned m_size;
+          unsigned m_capacity;
+      };
+
+      typedef InlineArray<Node, 2> NodeArray;
+      typedef InlineArray<Attribute*, 4> AttributeArray;
+
+      class ChildIndex;
+
+      // A prefixed namespace declaration, linked to the declarations in scope where it was
+      // made. Nested Tags refer to the same (reference-counted) chain instead of copying it.
+      // The reference count is not synchronized, so a chain is only shared within one tree.
+      struct NamespaceScope
+      {
+        NamespaceScope( const std::string& _prefix, const std::string& _xmlns,
+                        NamespaceScope* _parent )
+          : prefix( _prefix ), xmlns( _xmlns ), parent( _parent ), refs( 1 ) {}
+
+        // adds a declaration to the given chain, taking over the caller's reference to it
+        static NamespaceScope* push( NamespaceScope* scope, const std::string& prefix,
+                                     const std::string& xmlns )
+          { return new NamespaceScope( prefix, xmlns, scope ); }
+        static NamespaceScope* ref( NamespaceScope* scope )
+          { if( scope ) ++scope->refs; return scope; }
+        static void release( NamespaceScope* scope );
+        static NamespaceScope* copy( const NamespaceScope* scope );
+
+        std::string prefix;
+        std::string xmlns;
+        NamespaceScope* parent;
+        int refs;
+      };
+
+      // contents shared by several Tags, see share()
+      struct SharedData
+      {
+        // returns the new reference count
+        static long addRefs( SharedData* shared, long delta );
+        static void release( SharedData* shared );
+
+        Tag* tag;                       // holds the shared attributes, character data and children
+        const Tag* owner;               // the Tag share() was called on, the children's parent
+        volatile long refs;             // changed atomically, Tags sharing contents may be
+                                        // used from different threads
+        std::string xml;                // the serialized contents
+      };
+
+      Tag* copyElement() const;
+
+      const Tag* content() const { return m_shared ? m_shared->tag : this; }
+      void detach() const { if( m_shared ) unshare(); }
+      void unshare() const;
+      void takeContents( Tag* from );
+      void setContentParent( Tag* parent );
+      void releaseShared() const;
+      void copyContents( const Tag* from );
 
       Tag* m_parent;
-      TagList* m_children;
-      StringPList* m_cdata;
-      AttributeList* m_attribs;
-      NodeList* m_nodes;
-      std::string m_name;
-      std::string m_xmlns;
-      StringMap* m_xmlnss;
-      std::string m_prefix;
+      NodeArray m_nodes;                // child elements and character data, in document order
+      AttributeArray m_attribs;
+      TagList* m_childView;             // the child elements, as returned by children()
+      AttributeList* m_attribView;      // the attributes, as returned by attributes()
+      ChildIndex* m_childIndex;         // only for Tags with many child elements
+      mutable SharedData* m_shared;
+      mutable std::string* m_xmlCache;  // empty while invalid, see setXmlCaching()
+      Atom m_name;
+      Atom m_xmlns;
+      NamespaceScope* m_scope;         // innermost namespace declaration in scope, may be 0
+      Atom m_prefix;
+      TagArena* m_arena;
 
       enum TokenType
       {
@@ -671,36 +1042,43 @@ namespace gloox
         XTDoubleSlash
       };
 
-      /**
-       * Sets a list of namespaces.
-       * @param xmlnss The list of namespaces.
-       * @since 1.0
-       */
-      void setXmlns( StringMap* xmlns )
-        { delete m_xmlnss; m_xmlnss = xmlns; }
-
-      Tag* parse( const std::string& expression, unsigned& len, TokenType border = XTNone ) const;
+      static Tag* parse( const std::string& expression, unsigned& len, TokenType border = XTNone );
 
-      void closePreviousToken( Tag**, Tag**, TokenType&, std::string& ) const;
-      void addToken( Tag **root, Tag **current, TokenType type, const std::string& token ) const;
-      void addOperator( Tag **root, Tag **current, Tag* arg, TokenType type,
-                        const std::string& token ) const;
-      bool addPredicate( Tag **root, Tag **current, Tag* token ) const;
+      static void closePreviousToken( Tag**, Tag**, TokenType&, std::string& );
+      static void addToken( Tag **root, Tag **current, TokenType type, const std::string& token );
+      static void addOperator( Tag **root, Tag **current, Tag* arg, TokenType type,
+                               const std::string& token );
+      static bool addPredicate( Tag **root, Tag **current, Tag* token );
 
-      TagList findChildren( const TagList& list, const std::string& name,
-                            const std::string& xmlns = EmptyString ) const;
-      ConstTagList evaluateTagList( Tag* token ) const;
-      ConstTagList evaluateUnion( Tag* token ) const;
+      static const Node* nextNode( const Node* it, const Node* end, NodeType type );
+      ConstTagList evaluateTagList( const Tag* token ) const;
+      ConstTagList evaluateTagList( const Tag* token, TokenType type ) const;
+      ConstTagList evaluateUnion( const Tag* token ) const;
       ConstTagList allDescendants() const;
 
+      std::string::size_type xmlSize() const;
+      void serialize( std::string& out ) const;
+      void serializeElement( std::string& out ) const;
+      void serializeContents( std::string& out ) const;
+      void invalidateXml();
+
+      struct NameRef;
+      const Attribute* matchAttribute( const NameRef& name ) const;
+      Tag* matchChild( const NameRef& name, const std::string& attr,
+                       const std::string& value ) const;
+      TagList matchChildren( const NameRef& name, const std::string& xmlns ) const;
+      void buildChildIndex();
+
       static TokenType getType( const std::string& c );
 
       static bool isWhitespace( const char c );
       bool isNumber() const;
 
-      bool evaluateBoolean( Tag* token ) const;
-      bool evaluatePredicate( Tag* token ) const { return evaluateBoolean( token ); }
-      bool evaluateEquals( Tag* token ) const;
+      static TokenType tokenType( const Tag* token );
+
+      bool evaluateBoolean( const Tag* token ) const;
+      bool evaluatePredicate( const Tag* token ) const { return evaluateBoolean( token ); }
+      bool evaluateEquals( const Tag* token ) const;
 
       static void add( ConstTagList& one, const ConstTagList& two );
   };
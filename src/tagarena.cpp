@@ -0,0 +1,100 @@
+/*
+  Copyright (c) 2009 by Jakob Schroeter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#include "tagarena.h"
+
+#include <new>
+
+namespace gloox
+{
+
+  union Align
+  {
+    long double ld;
+    double d;
+    long l;
+    void* p;
+  };
+
+  static inline std::size_t align( std::size_t size )
+  {
+    return ( size + sizeof( Align ) - 1 ) & ~( sizeof( Align ) - 1 );
+  }
+
+  TagArena::TagArena( std::size_t blockSize )
+    : m_first( 0 ), m_current( 0 ), m_pos( 0 ), m_end( 0 ),
+      m_blockSize( align( blockSize ) ), m_allocated( 0 )
+  {
+  }
+
+  TagArena::~TagArena()
+  {
+    while( m_first )
+    {
+      Block* b = m_first;
+      m_first = m_first->next;
+      ::operator delete( b );
+    }
+  }
+
+  TagArena::Block* TagArena::newBlock( std::size_t size )
+  {
+    Block* b = static_cast<Block*>( ::operator new( align( sizeof( Block ) ) + size ) );
+    b->next = 0;
+    b->size = size;
+    return b;
+  }
+
+  void* TagArena::allocate( std::size_t size )
+  {
+    size = align( size ? size : 1 );
+
+    if( static_cast<std::size_t>( m_end - m_pos ) < size )
+    {
+      Block* b = newBlock( size > m_blockSize ? size : m_blockSize );
+      if( m_current )
+        m_current->next = b;
+      else
+        m_first = b;
+      m_current = b;
+      m_pos = reinterpret_cast<char*>( b ) + align( sizeof( Block ) );
+      m_end = m_pos + b->size;
+    }
+
+    void* p = m_pos;
+    m_pos += size;
+    m_allocated += size;
+    return p;
+  }
+
+  void TagArena::reset()
+  {
+    if( !m_first )
+      return;
+
+    Block* b = m_first->next;
+    while( b )
+    {
+      Block* t = b;
+      b = b->next;
+      ::operator delete( t );
+    }
+
+    m_first->next = 0;
+    m_current = m_first;
+    m_pos = reinterpret_cast<char*>( m_first ) + align( sizeof( Block ) );
+    m_end = m_pos + m_first->size;
+    m_allocated = 0;
+  }
+
+}
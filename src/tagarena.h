@@ -0,0 +1,97 @@
+/*
+  Copyright (c) 2009 by Jakob Schroeter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef TAGARENA_H__
+#define TAGARENA_H__
+
+#include "macros.h"
+
+#include <cstddef>
+
+namespace gloox
+{
+
+  /**
+   * @brief A bump allocator for Tag trees.
+   *
+   * A TagArena hands out memory from large blocks and releases all of it at once
+   * in reset(). Tag, Tag::Attribute and Tag-internal nodes can be placed into an
+   * arena using e.g. <tt>new( arena ) Tag( "foo" )</tt>. Deleting such an object runs its
+   * destructor as usual but does not free any memory; that only happens in reset().
+   *
+   * The Parser can use a TagArena for all elements of a top-level stanza (see
+   * Parser::setArena()). Such a Tag is valid only while TagHandler::handleTag() runs. Use
+   * Tag::clone() to obtain an independent, heap-allocated copy if you need to keep it.
+   *
+   * @author Jakob Schroeter <js@camaya.net>
+   * @since 1.0
+   */
+  class GLOOX_API TagArena
+  {
+    public:
+      /**
+       * Creates a new, empty arena.
+       * @param blockSize The size of the memory blocks to allocate from the heap.
+       */
+      TagArena( std::size_t blockSize = 16384 );
+
+      /**
+       * Destructor. Frees all memory blocks. Objects still living in the arena are not
+       * destroyed.
+       */
+      ~TagArena();
+
+      /**
+       * Returns a chunk of memory of at least the given size, suitably aligned for any
+       * object.
+       * @param size The number of bytes requested.
+       * @return A pointer to the memory chunk.
+       */
+      void* allocate( std::size_t size );
+
+      /**
+       * Makes all memory handed out so far available again. The first block is kept for
+       * re-use, all other blocks are released.
+       */
+      void reset();
+
+      /**
+       * Returns the number of bytes handed out since the last reset().
+       * @return The number of bytes allocated.
+       */
+      std::size_t allocated() const { return m_allocated; }
+
+    private:
+      TagArena( const TagArena& );
+      TagArena& operator=( const TagArena& );
+
+      struct Block
+      {
+        Block* next;
+        std::size_t size;
+      };
+
+      Block* newBlock( std::size_t size );
+
+      Block* m_first;
+      Block* m_current;
+      char* m_pos;
+      char* m_end;
+      std::size_t m_blockSize;
+      std::size_t m_allocated;
+
+  };
+
+}
+
+#endif // TAGARENA_H__
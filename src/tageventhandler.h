@@ -0,0 +1,90 @@
+/*
+  Copyright (c) 2009 by Jakob Schroeter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef TAGEVENTHANDLER_H__
+#define TAGEVENTHANDLER_H__
+
+#include "macros.h"
+
+#include <string>
+
+namespace gloox
+{
+
+  /**
+   * @brief A virtual interface which can be reimplemented to receive parsed XML as a
+   * sequence of events instead of as a Tag tree.
+   *
+   * A TagEventHandler can be registered with a Parser either for all incoming XML (see
+   * Parser::setEventHandler()) or for the contents of certain elements only (see
+   * Parser::registerEventHandler() and ClientBase::registerTagEventHandler()). The latter
+   * allows to process, e.g., the items of a very large roster or pubsub result one by one,
+   * without the Parser materializing them as Tags first.
+   *
+   * For every element, handleStartElement() is called first, followed by one call to
+   * handleAttribute() per attribute (including namespace declarations), any number of calls
+   * to handleText() and nested elements, and finally handleEndElement().
+   *
+   * The strings passed to these functions are only valid for the duration of the call.
+   *
+   * @author Jakob Schroeter <js@camaya.net>
+   * @since 1.0
+   */
+  class GLOOX_API TagEventHandler
+  {
+    public:
+      /**
+       * Virtual Destructor.
+       */
+      virtual ~TagEventHandler() {}
+
+      /**
+       * This function is called when an element starts.
+       * @param name The element's name.
+       * @param prefix The element's prefix, if any.
+       * @param xmlns The element's namespace. This is the namespace bound to @c prefix
+       * if the element is prefixed, or the default namespace in scope otherwise.
+       */
+      virtual void handleStartElement( const std::string& name, const std::string& prefix,
+                                       const std::string& xmlns ) = 0;
+
+      /**
+       * This function is called once for every attribute of the element most recently
+       * started. Namespace declarations are reported as attributes as well, either named
+       * 'xmlns' or prefixed with 'xmlns'.
+       * @param name The attribute's name.
+       * @param prefix The attribute's prefix, if any.
+       * @param value The attribute's (unescaped) value.
+       */
+      virtual void handleAttribute( const std::string& name, const std::string& prefix,
+                                    const std::string& value ) = 0;
+
+      /**
+       * This function is called for character data inside the current element. A single run
+       * of text may be reported in several chunks.
+       * @param text The (unescaped) character data.
+       */
+      virtual void handleText( const std::string& text ) = 0;
+
+      /**
+       * This function is called when an element ends.
+       * @param name The element's name.
+       * @param prefix The element's prefix, if any.
+       */
+      virtual void handleEndElement( const std::string& name, const std::string& prefix ) = 0;
+
+  };
+
+}
+
+#endif // TAGEVENTHANDLER_H__
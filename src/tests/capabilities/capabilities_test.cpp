@@ -72,6 +72,19 @@ int main( int /*argc*/, char** /*argv*/ )
   }
 
 
+  // -------
+  name = "appendXml()";
+  c.setNode( "http://gloox.camaya.net" );
+  Tag* t = c.tag();
+  std::string out;
+  c.appendXml( out );
+  if( !t || out != t->xml() )
+  {
+    ++fail;
+    printf( "test '%s' failed: %s\n", name.c_str(), out.c_str() );
+  }
+  delete t;
+
 
 
   printf( "Capabilities: " );
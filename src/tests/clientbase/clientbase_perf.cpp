@@ -0,0 +1,150 @@
+#ifndef _WIN32
+
+#include "../../clientbase.h"
+#include "../../iqhandler.h"
+#include "../../iq.h"
+#include "../../tag.h"
+using namespace gloox;
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <cstdio> // [s]print[f]
+
+#include <pthread.h>
+#include <sys/time.h>
+
+static double divider = 1000000;
+static int num = 200000;
+static double t;
+
+static void printTime ( const char * testName, struct timeval tv1, struct timeval tv2 )
+{
+  t = tv2.tv_sec - tv1.tv_sec;
+  t +=  ( tv2.tv_usec - tv1.tv_usec ) / divider;
+  printf( "%s: %.03f seconds (%.00f/s)\n", testName, t, num / t );
+}
+
+class ClientBasePerf : public ClientBase
+{
+  public:
+    ClientBasePerf() : ClientBase( "a", "b", 1 ) {}
+    virtual ~ClientBasePerf() {}
+    virtual void handleStartNode() {}
+    virtual bool handleNormalNode( Tag* ) { return false; }
+    virtual void rosterFilled() {}
+};
+
+class IqCounter : public IqHandler
+{
+  public:
+    IqCounter() : m_count( 0 ) {}
+    virtual ~IqCounter() {}
+    virtual bool handleIq( const IQ& /*iq*/ ) { return false; }
+    virtual void handleIqID( const IQ& /*iq*/, int /*context*/ ) { ++m_count; }
+    int m_count;
+};
+
+struct Sender
+{
+  ClientBase* c;
+  IqHandler* ih;
+  int thread;
+  int count;
+};
+
+static std::string id( int thread, int i )
+{
+  char tmp[24];
+  sprintf( tmp, "perf:%d:%d", thread, i );
+  return tmp;
+}
+
+static void* send( void* arg )
+{
+  Sender* s = static_cast<Sender*>( arg );
+  const JID to( "x@y/z" );
+  for( int i = 0; i < s->count; ++i )
+  {
+    IQ iq( IQ::Get, to, id( s->thread, i ) );
+    s->c->send( iq, s->ih, 0 );
+  }
+  return 0;
+}
+
+// 'threads' threads send IQs tracked with an IqHandler while the calling thread resolves
+// as many IQs sent beforehand by handing the replies to the ClientBase.
+static void contention( int threads )
+{
+  ClientBasePerf* c = new ClientBasePerf();
+  IqCounter sent;
+  IqCounter resolved;
+  std::vector<Tag*> replies;
+  const JID to( "x@y/z" );
+  for( int i = 0; i < num; ++i )
+  {
+    IQ iq( IQ::Get, to, id( -1, i ) );
+    c->send( iq, &resolved, 0 );
+    Tag* r = new Tag( "iq" );
+    r->addAttribute( "type", "result" );
+    r->addAttribute( "id", iq.id() );
+    replies.push_back( r );
+  }
+
+  std::vector<Sender> senders( threads );
+  std::vector<pthread_t> tids( threads );
+
+  struct timeval tv1;
+  struct timeval tv2;
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < threads; ++i )
+  {
+    senders[i].c = c;
+    senders[i].ih = &sent;
+    senders[i].thread = i;
+    senders[i].count = num / threads;
+    pthread_create( &tids[i], 0, send, &senders[i] );
+  }
+  std::vector<Tag*>::const_iterator it = replies.begin();
+  for( ; it != replies.end(); ++it )
+    c->handleTag( (*it) );
+  for( int i = 0; i < threads; ++i )
+    pthread_join( tids[i], 0 );
+  gettimeofday( &tv2, 0 );
+
+  char name[64];
+  sprintf( name, "send/resolve, %d sender thread(s)", threads );
+  printTime( name, tv1, tv2 );
+  if( resolved.m_count != num )
+    printf( "  %d of %d IQs resolved\n", resolved.m_count, num );
+
+  for( it = replies.begin(); it != replies.end(); ++it )
+    delete (*it);
+  c->removeIDHandler( &sent );
+  delete c;
+}
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  printf( "Testing %d...\n", num );
+
+  struct timeval tv1;
+  struct timeval tv2;
+  ClientBasePerf* c = new ClientBasePerf();
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    c->getID();
+  gettimeofday( &tv2, 0 );
+  printTime( "getID", tv1, tv2 );
+  delete c;
+
+  contention( 1 );
+  contention( 2 );
+  contention( 4 );
+  contention( 8 );
+
+  return 0;
+}
+#else
+int main( int, char** ) { return 0; }
+#endif
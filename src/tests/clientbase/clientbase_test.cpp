@@ -3,20 +3,29 @@
 // #include "../../logsink.h"
 // #include "../../loghandler.h"
 #include "../../connectionlistener.h"
+#include "../../messagesession.h"
+#include "../../messagehandler.h"
+#include "../../message.h"
+#include "../../presencehandler.h"
+#include "../../presence.h"
+#include "../../iq.h"
+#include "../../error.h"
 #include "../../gloox.h"
 using namespace gloox;
 
 #include <stdio.h>
 #include <locale.h>
+#include <set>
 #include <string>
 #include <cstdio> // [s]print[f]
+#include <ctime>
 
 class ClientBaseTest : public ClientBase, /*LogHandler,*/ ConnectionListener
 {
   public:
     ClientBaseTest( const std::string& ns, const std::string& server, int port = -1 )
       : ClientBase( ns, server, port ), m_handleStartNodeCalled( false ),
-        m_versionOK( false )
+        m_versionOK( false ), m_normalNodes( false )
     {
       m_jid.setUsername( "test" );
       m_jid.setServer( server );
@@ -26,7 +35,7 @@ class ClientBaseTest : public ClientBase, /*LogHandler,*/ ConnectionListener
     }
     virtual ~ClientBaseTest() {}
     virtual void handleStartNode() { m_handleStartNodeCalled = true; }
-    virtual bool handleNormalNode(gloox::Tag*) { return true; }
+    virtual bool handleNormalNode(gloox::Tag*) { return !m_normalNodes; }
     virtual void rosterFilled() {}
 /*    virtual void handleLog( LogLevel level, LogArea area, const std::string& message )
     {
@@ -40,6 +49,7 @@ class ClientBaseTest : public ClientBase, /*LogHandler,*/ ConnectionListener
     bool handleStartNodeCalled() const { return m_handleStartNodeCalled; }
     bool sidOK() const { return ( m_sid == "testsid" ); }
     bool versionOK() const { return m_versionOK; }
+    void setNormalNodes( bool normal ) { m_normalNodes = normal; }
 
   protected:
       virtual bool checkStreamVersion( const std::string& version )
@@ -51,8 +61,80 @@ class ClientBaseTest : public ClientBase, /*LogHandler,*/ ConnectionListener
   private:
     bool m_handleStartNodeCalled;
     bool m_versionOK;
+    bool m_normalNodes;
 };
 
+class MessageRecorder : public MessageHandler
+{
+  public:
+    MessageRecorder() : m_session( 0 ) {}
+    virtual ~MessageRecorder() {}
+    virtual void handleMessage( const Message& /*msg*/, MessageSession* session )
+    {
+      m_session = session;
+    }
+
+    MessageSession* m_session;
+};
+
+class PresenceRecorder : public PresenceHandler
+{
+  public:
+    PresenceRecorder( ClientBase* parent = 0, const JID& jid = JID() )
+      : m_parent( parent ), m_jid( jid ), m_count( 0 ) {}
+    virtual ~PresenceRecorder() {}
+    virtual void handlePresence( const Presence& /*presence*/ )
+    {
+      ++m_count;
+      if( m_parent )
+        m_parent->removePresenceHandler( m_jid, this );
+    }
+
+    ClientBase* m_parent;
+    JID m_jid;
+    int m_count;
+};
+
+class IqRecorder : public IqHandler
+{
+  public:
+    IqRecorder() : m_contexts( 0 ), m_timeouts( 0 ) {}
+    virtual ~IqRecorder() {}
+    virtual bool handleIq( const IQ& /*iq*/ ) { return false; }
+    virtual void handleIqID( const IQ& iq, int context )
+    {
+      m_contexts |= context;
+      const Error* e = iq.error();
+      if( iq.subtype() == IQ::Error && e && e->error() == StanzaErrorRemoteServerTimeout
+          && iq.from().full() == "x@y/z" )
+        ++m_timeouts;
+    }
+
+    int m_contexts;
+    int m_timeouts;
+};
+
+static void presence( ClientBaseTest* c, const std::string& from )
+{
+  Presence p( Presence::Available, JID( "test@b/gloox" ) );
+  p.setFrom( JID( from ) );
+  Tag* t = p.tag();
+  c->handleTag( t );
+  delete t;
+}
+
+static MessageSession* route( ClientBaseTest* c, MessageRecorder& rec,
+                              Message::MessageType type, const std::string& from )
+{
+  Message m( type, JID( "test@b/gloox" ), "body" );
+  m.setFrom( JID( from ) );
+  Tag* t = m.tag();
+  rec.m_session = 0;
+  c->handleTag( t );
+  delete t;
+  return rec.m_session;
+}
+
 class ConnectionImpl : public ConnectionBase
 {
   public:
@@ -180,6 +262,126 @@ int main( int /*argc*/, char** /*argv*/ )
   c = 0;
   t = 0;
 
+  // -------
+  {
+    name = "message session routing";
+    c = new ClientBaseTest( "a", "b", 1 );
+    c->setNormalNodes( true );
+    MessageRecorder rec;
+    MessageSession* s1 = new MessageSession( c, JID( "a@b/r1" ), false, Message::Chat );
+    MessageSession* s2 = new MessageSession( c, JID( "a@b" ) );
+    MessageSession* s3 = new MessageSession( c, JID( "x@y/r" ) );
+    s1->registerMessageHandler( &rec );
+    s2->registerMessageHandler( &rec );
+    s3->registerMessageHandler( &rec );
+    if( route( c, rec, Message::Chat, "a@b/r1" ) != s1
+        || route( c, rec, Message::Chat, "a@b/r2" ) != s1
+        || route( c, rec, Message::Normal, "a@b/r2" ) != s2   // upgrades s2 to a@b/r2
+        || s2->target().full() != "a@b/r2"
+        || route( c, rec, Message::Chat, "x@y/q" ) != s3
+        || route( c, rec, Message::Chat, "c@d/r" ) != 0 )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+    c->disposeMessageSession( s1 );
+    if( route( c, rec, Message::Chat, "a@b/r1" ) != s2 )
+    {
+      ++fail;
+      printf( "test '%s' failed after disposeMessageSession()\n", name.c_str() );
+    }
+    c->disposeMessageSession( s2 );
+    if( route( c, rec, Message::Chat, "a@b/r2" ) != 0 )
+    {
+      ++fail;
+      printf( "test '%s' failed after disposing all sessions of a JID\n", name.c_str() );
+    }
+    delete c;
+    c = 0;
+  }
+
+  // -------
+  {
+    name = "presence routing by JID";
+    c = new ClientBaseTest( "a", "b", 1 );
+    c->setNormalNodes( true );
+    PresenceRecorder all;
+    PresenceRecorder room1;
+    PresenceRecorder room2;
+    PresenceRecorder once( c, JID( "room2@conf" ) );
+    c->registerPresenceHandler( &all );
+    c->registerPresenceHandler( JID( "room1@conf/nick" ), &room1 );
+    c->registerPresenceHandler( JID( "room2@conf" ), &once );
+    c->registerPresenceHandler( JID( "room2@conf" ), &room2 );
+    presence( c, "room1@conf/a" );
+    presence( c, "room2@conf/a" );
+    presence( c, "room2@conf/b" );
+    presence( c, "x@y/z" );
+    c->removePresenceHandler( JID( "room1@conf" ), 0 );
+    presence( c, "room1@conf/a" );
+    if( all.m_count != 2 || room1.m_count != 1 || room2.m_count != 2 || once.m_count != 1 )
+    {
+      ++fail;
+      printf( "test '%s' failed: %d %d %d %d\n", name.c_str(), all.m_count, room1.m_count,
+              room2.m_count, once.m_count );
+    }
+    c->removePresenceHandler( JID( "room2@conf" ), &room2 );
+    delete c;
+    c = 0;
+  }
+
+  // -------
+  {
+    name = "IQ timeouts";
+    c = new ClientBaseTest( "a", "b", 1 );
+    c->setNormalNodes( true );
+    IqRecorder rec;
+    IQ iq1( IQ::Get, JID( "x@y/z" ), "iq1" );
+    IQ iq2( IQ::Get, JID( "x@y/z" ), "iq2" );
+    IQ iq3( IQ::Get, JID( "x@y/z" ), "iq3" );
+    c->send( iq1, &rec, 1, false, 1 );
+    c->send( iq2, &rec, 2 );
+    c->send( iq3, &rec, 4, false, 1 );
+    Tag* r = new Tag( "iq" );
+    r->addAttribute( "type", "result" );
+    r->addAttribute( "id", "iq3" );
+    c->handleTag( r );
+    delete r;
+    const time_t start = time( 0 );
+    while( !rec.m_timeouts && time( 0 ) - start < 4 )
+      c->handleReceivedData( 0, EmptyString );
+    if( rec.m_timeouts != 1 || rec.m_contexts != 5 || time( 0 ) - start < 1 )
+    {
+      ++fail;
+      printf( "test '%s' failed: %d %d\n", name.c_str(), rec.m_timeouts, rec.m_contexts );
+    }
+    c->removeIDHandler( &rec );
+    delete c;
+    c = 0;
+  }
+
+  // -------
+  {
+    name = "getID()";
+    c = new ClientBaseTest( "a", "b", 1 );
+    ClientBaseTest* c2 = new ClientBaseTest( "a", "b", 1 );
+    std::set<std::string> ids;
+    const std::string first = c->getID();
+    const std::string other = c2->getID();
+    ids.insert( first );
+    for( int i = 0; i < 1000; ++i )
+      ids.insert( c->getID() );
+    if( ids.size() != 1001 || first.length() != 21 || first.substr( 0, 4 ) != "uid:"
+        || c->getID().substr( 0, 13 ) != first.substr( 0, 13 )
+        || other.substr( 0, 13 ) == first.substr( 0, 13 ) )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s %s\n", name.c_str(), first.c_str(), other.c_str() );
+    }
+    delete c2;
+    delete c;
+    c = 0;
+  }
 
 
 
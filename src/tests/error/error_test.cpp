@@ -34,6 +34,19 @@ int main( int /*argc*/, char** /*argv*/ )
     printf( "text: %s\n", e->text().c_str() );
     ++fail;
   }
+
+  // -------
+  name = "appendXml()";
+  Tag* t = e->tag();
+  std::string out;
+  e->appendXml( out );
+  if( out != t->xml() )
+  {
+    printf( "failed: '%s' test\n", name.c_str() );
+    printf( "xml: %s\n", out.c_str() );
+    ++fail;
+  }
+  delete t;
   // -------
 
   delete error;
@@ -10,6 +10,17 @@ using namespace gloox;
 #include <string>
 #include <cstdio> // [s]print[f]
 
+class TestExtension : public StanzaExtension
+{
+  public:
+    TestExtension( int type = ExtUser + 1 ) : StanzaExtension( type ) {}
+    virtual ~TestExtension() {}
+    virtual const std::string& filterString() const { return EmptyString; }
+    virtual StanzaExtension* newInstance( const Tag* /*tag*/ ) const { return new TestExtension(); }
+    virtual Tag* tag() const { return new Tag( "query", "xmlns", "test" ); }
+    virtual StanzaExtension* clone() const { return new TestExtension(); }
+};
+
 int main( int /*argc*/, char** /*argv*/ )
 {
   int fail = 0;
@@ -128,6 +139,57 @@ int main( int /*argc*/, char** /*argv*/ )
     delete i;
   }
 
+  // -------
+  {
+    name = "appendXml()";
+    IQ iq( IQ::Set, JID( "xyz@example.org/blah" ), "id'3" );
+    iq.addExtension( new TestExtension() );
+    Tag* i = iq.tag();
+    std::string out;
+    iq.appendXml( out );
+    if( out != i->xml() )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), out.c_str() );
+    }
+    out = "";
+    iq.appendXml( out, "me@example.net/gloox", "jabber:client" );
+    if( out != "<iq to='xyz@example.org/blah' id='id&apos;3' type='set' from='me@example.net/gloox' "
+               "xmlns='jabber:client'><query xmlns='test'/></iq>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), out.c_str() );
+    }
+    delete i;
+  }
+
+  // -------
+  {
+    name = "findExtension()";
+    IQ iq( IQ::Set, JID( "xyz@example.org/blah" ), "id4" );
+    const StanzaExtension* u = new TestExtension();
+    const StanzaExtension* v = new TestExtension( ExtVersion );
+    const StanzaExtension* d1 = new TestExtension( ExtDelay );
+    const StanzaExtension* d2 = new TestExtension( ExtDelay );
+    iq.addExtension( u );
+    iq.addExtension( d1 );
+    iq.addExtension( v );
+    iq.addExtension( d2 );
+    if( iq.findExtension( ExtUser + 1 ) != u || iq.findExtension( ExtVersion ) != v
+        || iq.findExtension( ExtDelay ) != d1 || iq.findExtension( ExtError )
+        || iq.findExtension( ExtUser + 2 ) || iq.findExtension( -1 ) )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+    iq.removeExtensions();
+    if( iq.findExtension( ExtVersion ) || iq.findExtension( ExtUser + 1 ) )
+    {
+      ++fail;
+      printf( "test '%s' failed after removeExtensions()\n", name.c_str() );
+    }
+  }
+
 // FIXME these need to use SEs, as IQ::query() will go away eventually
 //   // -------
 //   {
@@ -63,6 +63,28 @@ int main( int /*argc*/, char** /*argv*/ )
   delete i;
   i = 0;
 
+  // -------
+  name = "parse Message chat lazily";
+  i = new Message( msg, true );
+  if( i->subtype() != Message::Chat || i->id() != "id1"
+      || i->from().full() != "me@example.net/gloox" || i->to().full() != "you@example.net/gloox"
+      || i->body() != "the body" || !i->thread().empty() )
+  {
+    ++fail;
+    printf( "test '%s' failed\n", name.c_str() );
+  }
+  i->setThread( "abc" );
+  Tag* lt = i->tag();
+  if( i->thread() != "abc" || !lt || lt->findChild( "body" )->cdata() != "the body"
+      || lt->findAttribute( "from" ) != "me@example.net/gloox" )
+  {
+    ++fail;
+    printf( "test '%s' failed\n", name.c_str() );
+  }
+  delete lt;
+  delete i;
+  i = 0;
+
   // -------
   name = "parse Message groupchat";
   msg->addAttribute( "type", "groupchat" );
@@ -208,6 +230,32 @@ int main( int /*argc*/, char** /*argv*/ )
   delete tag;
   tag = 0;
 
+  // -------
+  {
+    name = "appendXml()";
+    Message m( Message::Chat, JID( "you@example.net/gloox" ), "a < b", "subject", "thread" );
+    Message e( Message::Headline, JID() );
+    Tag* mt = m.tag();
+    Tag* et = e.tag();
+    std::string out;
+    m.appendXml( out );
+    e.appendXml( out );
+    if( out != mt->xml() + et->xml() )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), out.c_str() );
+    }
+    out = "";
+    e.appendXml( out, "me@example.net/gloox", "jabber:client" );
+    if( out != "<message type='headline' from='me@example.net/gloox' xmlns='jabber:client'/>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), out.c_str() );
+    }
+    delete mt;
+    delete et;
+  }
+
 
 
 
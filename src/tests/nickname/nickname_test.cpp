@@ -50,6 +50,20 @@ int main( int /*argc*/, char** /*argv*/ )
     delete t;
   }
 
+  // -------
+  {
+    name = "appendXml()";
+    Nickname n( "f<o&o" );
+    Tag* t = n.tag();
+    std::string out;
+    n.appendXml( out );
+    if( out != t->xml() )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), out.c_str() );
+    }
+    delete t;
+  }
 
 
   if( fail == 0 )
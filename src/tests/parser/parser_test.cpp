@@ -6,8 +6,52 @@ using namespace gloox;
 #include <stdio.h>
 #include <locale.h>
 #include <string>
+#include <vector>
 #include <cstdio> // [s]print[f]
 
+class EventRecorder : public TagEventHandler
+{
+  public:
+    virtual ~EventRecorder() {}
+
+    virtual void handleStartElement( const std::string& name, const std::string& prefix,
+                                     const std::string& xmlns )
+    {
+      m_log += "S(" + name + "," + prefix + "," + xmlns + ")";
+    }
+
+    virtual void handleAttribute( const std::string& name, const std::string& prefix,
+                                  const std::string& value )
+    {
+      m_log += "A(" + name + "," + prefix + "," + value + ")";
+    }
+
+    virtual void handleText( const std::string& text )
+    {
+      m_log += "T(" + text + ")";
+    }
+
+    virtual void handleEndElement( const std::string& name, const std::string& prefix )
+    {
+      m_log += "E(" + name + "," + prefix + ")";
+    }
+
+    std::string m_log;
+};
+
+class ViewRecorder : public StanzaViewHandler
+{
+  public:
+    virtual ~ViewRecorder() {}
+
+    virtual void handleStanzaView( const StanzaView& view )
+    {
+      m_views.push_back( view );
+    }
+
+    std::vector<StanzaView> m_views;
+};
+
 class ParserTest : private TagHandler
 {
   public:
@@ -1183,6 +1227,39 @@ class ParserTest : private TagHandler
       delete m_tag;
       m_tag = 0;
 
+      //-------
+      name = "re-declared prefixes and detached children";
+      data = "<a xmlns:p='one' xmlns:q='two'><b xmlns:p='three'><p:c><q:d/></p:c></b><p:e/></a>";
+      if( ( i = p->feed( data ) ) >= 0 || !m_tag || m_tag->xml() != data )
+      {
+        ++fail;
+        printf( "test '%s' failed (%d): \n%s\n", name.c_str(), i, data.c_str() );
+      }
+      else
+      {
+        Tag* c = m_tag->findChild( "b" )->findChild( "c" )->clone();
+        Tag* d = m_tag->findChild( "b" )->findChild( "c" )->findChild( "d" );
+        if( c->xmlns() != "three" || c->xmlns( "q" ) != "two" || c->prefix( "two" ) != "q"
+            || c->prefix( "one" ) != "" || d->xmlns() != "two" || d->xmlns( "p" ) != "three"
+            || m_tag->findChild( "e" )->xmlns() != "one" || m_tag->prefix( "one" ) != "p" )
+        {
+          ++fail;
+          printf( "test '%s' failed: %s %s\n", name.c_str(), c->xmlns().c_str(), d->xmlns().c_str() );
+        }
+        delete m_tag;
+        m_tag = 0;
+        // the clone has its own copy of the declarations in scope
+        if( c->xmlns() != "three" || c->xmlns( "q" ) != "two" || c->xmlns( "p" ) != "three"
+            || c->findChild( "d" )->xmlns() != "two" )
+        {
+          ++fail;
+          printf( "test '%s' failed: clone: %s\n", name.c_str(), c->xml().c_str() );
+        }
+        delete c;
+      }
+      delete m_tag;
+      m_tag = 0;
+
 
 // <abc xmlns='def' xmlns:xx='xyz' xmlns:foo='ggg' foo:attr='val'><xx:dff><foo:bar/></xx:dff></abc>
 
@@ -1199,27 +1276,253 @@ class ParserTest : private TagHandler
       delete m_tag;
       m_tag = 0;
 
+      //-------
+      name = "split escaping in attribute value";
+      data = "<tag1 attr='a&q";
+      if( ( i = p->feed( data ) ) >= 0 || m_tag )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, data.c_str() );
+      }
+      data = "uot;b'/>";
+      if( ( i = p->feed( data ) ) >= 0 || !m_tag || !m_tag->hasAttribute( "attr", "a\"b" ) )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, data.c_str() );
+      }
+      delete m_tag;
+      m_tag = 0;
 
+      //-------
+      name = "split ]]> with extra brackets";
+      data = "<tag1><![CDATA[ab]]";
+      if( ( i = p->feed( data ) ) >= 0 || m_tag )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, data.c_str() );
+      }
+      data = "]";
+      if( ( i = p->feed( data ) ) >= 0 || m_tag )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, data.c_str() );
+      }
+      data = "></tag1>";
+      if( ( i = p->feed( data ) ) >= 0 || !m_tag || m_tag->cdata() != "ab]" )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, data.c_str() );
+      }
+      delete m_tag;
+      m_tag = 0;
 
+      //-------
+      name = "overlong split entity";
+      data = "<tag1>&abcdef";
+      if( ( i = p->feed( data ) ) >= 0 || m_tag )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, data.c_str() );
+      }
+      data = "ghijk;</tag1>";
+      if( ( i = p->feed( data ) ) < 0 )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, data.c_str() );
+      }
+      delete m_tag;
+      m_tag = 0;
 
+      //-------
+      name = "long text and attribute runs";
+      data = "<tag1 attr=\"0123456789abcdefghijklmnopqrstuvwxyz&quot;0123456789'abc\">"
+             "0123456789abcdefghijklmnopqrstuvwxyz&lt;0123456789abcdefghijklmnopqrstuvwxyz"
+             "<![CDATA[0123456789abcdefghijklmnopqrstuvwxyz]0123456789abcdefghijklmnopqrstuvwxyz]]>"
+             "</tag1>";
+      if( ( i = p->feed( data ) ) >= 0 || !m_tag
+          || !m_tag->hasAttribute( "attr", "0123456789abcdefghijklmnopqrstuvwxyz\"0123456789'abc" )
+          || m_tag->cdata() != "0123456789abcdefghijklmnopqrstuvwxyz<0123456789abcdefghijklmnopqrstuvwxyz"
+                               "0123456789abcdefghijklmnopqrstuvwxyz]0123456789abcdefghijklmnopqrstuvwxyz" )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, data.c_str() );
+      }
+      delete m_tag;
+      m_tag = 0;
 
+      //-------
+      name = "arena allocation";
+      p->setArena( true );
+      data = "<tag1 a='b'><child c='d'>text</child><child/></tag1>";
+      if( ( i = p->feed( data ) ) >= 0 || !m_tag
+          || m_tag->xml() != "<tag1 a='b'><child c='d'>text</child><child/></tag1>" )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, data.c_str() );
+      }
+      delete m_tag;
+      m_tag = 0;
+      data = "<tag2><x/></tag2>";
+      if( ( i = p->feed( data ) ) >= 0 || !m_tag || m_tag->xml() != data )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, data.c_str() );
+      }
+      delete m_tag;
+      m_tag = 0;
+      p->setArena( false );
 
+      //-------
+      name = "feed from a const buffer";
+      const char* buf = "<tag1 a='b'>c&amp;d</tag1><tag2/>";
+      if( ( i = p->feed( buf, 26 ) ) >= 0 || !m_tag || m_tag->name() != "tag1"
+          || m_tag->cdata() != "c&d" || !m_tag->hasAttribute( "a", "b" ) )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, buf );
+      }
+      delete m_tag;
+      m_tag = 0;
 
+      //-------
+      name = "event handler for the whole stream";
+      EventRecorder rec;
+      p->setEventHandler( &rec );
+      data = "<?xml version='1.0'?><stream:stream xmlns='jabber:client' "
+             "xmlns:stream='http://etherx.jabber.org/streams'><stream:features/>"
+             "<iq type='result'><query xmlns='jabber:iq:roster'><item jid='a@b'/>x &amp; y</query></iq>"
+             "</stream:stream>";
+      if( ( i = p->feed( data ) ) >= 0 || m_tag
+          || rec.m_log != "S(stream,stream,http://etherx.jabber.org/streams)"
+                          "A(xmlns,,jabber:client)A(stream,xmlns,http://etherx.jabber.org/streams)"
+                          "S(features,stream,http://etherx.jabber.org/streams)E(features,stream)"
+                          "S(iq,,jabber:client)A(type,,result)"
+                          "S(query,,jabber:iq:roster)A(xmlns,,jabber:iq:roster)"
+                          "S(item,,jabber:iq:roster)A(jid,,a@b)E(item,)T(x & y)E(query,)"
+                          "E(iq,)E(stream,stream)" )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, rec.m_log.c_str() );
+      }
+      delete m_tag;
+      m_tag = 0;
 
+      //-------
+      name = "event handler with mismatched end tag";
+      rec.m_log = EmptyString;
+      data = "<a><b></a>";
+      if( ( i = p->feed( data ) ) != 9 || rec.m_log != "S(a,,)S(b,,)" )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, rec.m_log.c_str() );
+      }
+      p->setEventHandler( 0 );
 
+      //-------
+      name = "event handler for a subtree";
+      rec.m_log = EmptyString;
+      p->registerEventHandler( &rec, "query", "jabber:iq:roster" );
+      data = "<iq type='result'><query xmlns='jabber:iq:roster' ver='1'><item jid='a@b'>"
+             "<group>g</group></item><item jid='c@d'/></query></iq>";
+      if( ( i = p->feed( data ) ) >= 0 || !m_tag
+          || m_tag->xml() != "<iq type='result'><query xmlns='jabber:iq:roster' ver='1'/></iq>"
+          || rec.m_log != "S(query,,jabber:iq:roster)A(xmlns,,jabber:iq:roster)A(ver,,1)"
+                          "S(item,,jabber:iq:roster)A(jid,,a@b)S(group,,jabber:iq:roster)T(g)"
+                          "E(group,)E(item,)S(item,,jabber:iq:roster)A(jid,,c@d)E(item,)E(query,)" )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, rec.m_log.c_str() );
+      }
+      delete m_tag;
+      m_tag = 0;
 
+      //-------
+      name = "event handler for an empty subtree";
+      rec.m_log = EmptyString;
+      data = "<iq><query xmlns='jabber:iq:roster'/><x/></iq>";
+      if( ( i = p->feed( data ) ) >= 0 || !m_tag
+          || m_tag->xml() != "<iq><query xmlns='jabber:iq:roster'/><x/></iq>"
+          || rec.m_log != "S(query,,jabber:iq:roster)A(xmlns,,jabber:iq:roster)E(query,)" )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, rec.m_log.c_str() );
+      }
+      delete m_tag;
+      m_tag = 0;
 
+      //-------
+      name = "event handler for another namespace";
+      rec.m_log = EmptyString;
+      data = "<iq><query xmlns='jabber:iq:version'><name>n</name></query></iq>";
+      if( ( i = p->feed( data ) ) >= 0 || !m_tag || m_tag->xml() != data || !rec.m_log.empty() )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, rec.m_log.c_str() );
+      }
+      delete m_tag;
+      m_tag = 0;
 
+      //-------
+      name = "removed event handler";
+      p->removeEventHandler( &rec );
+      data = "<iq><query xmlns='jabber:iq:roster'><item/></query></iq>";
+      if( ( i = p->feed( data ) ) >= 0 || !m_tag || m_tag->xml() != data || !rec.m_log.empty() )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d: %s\n", name.c_str(), i, rec.m_log.c_str() );
+      }
+      delete m_tag;
+      m_tag = 0;
 
-
-
-
-
-
-
-
-
-
+      //-------
+      name = "stanza views";
+      ViewRecorder views;
+      p->setStanzaViewHandler( &views );
+      const std::string message = "<message to='a@b/c' type='chat' xml:lang='en' id='x&amp;1'>"
+                                  "<body>hi &lt;3</body><x xmlns='jabber:x:event'><composing/></x>"
+                                  "<foo:y xmlns:foo='urn:foo'/></message>";
+      data = "<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams'>"
+             + message + " <presence/>";
+      // byte by byte, to check the raw bytes are kept across buffers
+      i = -1;
+      for( std::string::size_type j = 0; j < data.length() && i < 0; ++j )
+        i = p->feed( data.c_str() + j, 1 );
+      tfail = i >= 0 || !m_tag || m_tag->name() != "stream" || views.m_views.size() != 2;
+      if( !tfail )
+      {
+        const StanzaView& v = views.m_views[0];
+        const StanzaView::ElementList& c = v.children();
+        Tag* t = v.tag();
+        Tag* x = c.size() == 3 ? v.tag( c[1] ) : 0;
+        Tag* y = c.size() == 3 ? v.tag( c[2] ) : 0;
+        tfail = v.xml() != message || v.name() != "message" || !v.xmlns().empty()
+                || v.findAttribute( "to" ) != "a@b/c" || v.findAttribute( "type" ) != "chat"
+                || v.findAttribute( "xml:lang" ) != "en" || v.findAttribute( "id" ) != "x&1"
+                || v.hasAttribute( "from" ) || c.size() != 3
+                || c[0].name != "body" || !c[0].xmlns.empty()
+                || c[1].name != "x" || c[1].xmlns != "jabber:x:event"
+                || v.xml().substr( c[1].begin, c[1].end - c[1].begin )
+                     != "<x xmlns='jabber:x:event'><composing/></x>"
+                || c[2].name != "y" || c[2].xmlns != "urn:foo"
+                || !v.findChild( "x", "jabber:x:event" ) || v.findChild( "x", "jabber:x:data" )
+                || !t || t->xml() != message
+                || !x || x->xml() != "<x xmlns='jabber:x:event'><composing/></x>"
+                || !y || y->xmlns() != "urn:foo"
+                || views.m_views[1].xml() != "<presence/>" || views.m_views[1].name() != "presence"
+                || !views.m_views[1].children().empty();
+        delete t;
+        delete x;
+        delete y;
+      }
+      if( tfail )
+      {
+        ++fail;
+        printf( "test '%s' failed at pos %d\n", name.c_str(), i );
+      }
+      p->setStanzaViewHandler( 0 );
+      p->cleanup();
+      delete m_tag;
+      m_tag = 0;
 
       delete p;
       p = 0;
@@ -36,6 +36,33 @@ int main( int /*argc*/, char** /*argv*/ )
   delete i;
   i = 0;
 
+  // -------
+  name = "parse Presence lazily";
+  i = new Presence( pres, true );
+  if( i->subtype() != Presence::Available || i->priority() != 10
+      || i->to().full() != "you@example.net/gloox" || i->from().full() != "me@example.net/gloox"
+      || i->status() != "the status" )
+  {
+    ++fail;
+    printf( "test '%s' failed\n", name.c_str() );
+  }
+  delete i;
+  i = 0;
+
+  // -------
+  name = "lazy Presence: setters win over lazily decoded values";
+  i = new Presence( pres, true );
+  i->setPriority( 3 );
+  i->resetStatus();
+  i->setFrom( JID( "other@example.net" ) );
+  if( i->priority() != 3 || !i->status().empty() || i->from().full() != "other@example.net" )
+  {
+    ++fail;
+    printf( "test '%s' failed\n", name.c_str() );
+  }
+  delete i;
+  i = 0;
+
   // -------
   name = "parse Presence available";
   pres->addAttribute( "type", "available" );
@@ -304,6 +331,29 @@ int main( int /*argc*/, char** /*argv*/ )
     delete i;
   }
 
+  // -------
+  {
+    name = "appendXml()";
+    Presence p1( Presence::Away, JID( "xyz@example.org/blah" ), "the status", 10, "the xmllang" );
+    Presence p2( Presence::Available, JID(), "a & b" );
+    Presence p3( Presence::Unavailable, JID( "xyz@example.org" ) );
+    p3.setFrom( JID( "foo@bar.com" ) );
+    std::string out;
+    p1.appendXml( out );
+    p2.appendXml( out );
+    p3.appendXml( out, "me@example.net/gloox", "jabber:client" );
+    Tag* t1 = p1.tag();
+    Tag* t2 = p2.tag();
+    if( out != t1->xml() + t2->xml() + "<presence to='xyz@example.org' from='foo@bar.com' "
+                 "type='unavailable' xmlns='jabber:client'><priority>0</priority></presence>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), out.c_str() );
+    }
+    delete t1;
+    delete t2;
+  }
+
 
 
   delete pres;
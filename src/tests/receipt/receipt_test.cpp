@@ -57,6 +57,22 @@ int main( int /*argc*/, char** /*argv*/ )
     t = 0;
   }
 
+  // -------
+  {
+    name = "appendXml()";
+    Receipt r( Receipt::Request );
+    t = r.tag();
+    std::string out;
+    r.appendXml( out );
+    if( out != t->xml() )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), out.c_str() );
+    }
+    delete t;
+    t = 0;
+  }
+
   StanzaExtensionFactory sef;
   sef.registerExtension( new Receipt( Receipt::Invalid ) );
   // -------
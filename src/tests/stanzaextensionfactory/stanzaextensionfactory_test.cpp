@@ -35,6 +35,42 @@ class SETest : public StanzaExtension
 
 };
 
+class SEFilterTest : public StanzaExtension
+{
+  public:
+    SEFilterTest( int type, const std::string& filter, const Tag* tag = 0 )
+      : StanzaExtension( type ), m_filter( filter ), m_tag( tag ) {}
+    ~SEFilterTest() {}
+
+    virtual const std::string& filterString() const { return m_filter; }
+
+    virtual StanzaExtension* newInstance( const Tag* tag ) const
+    { return new SEFilterTest( extensionType(), m_filter, tag ); }
+
+    virtual Tag* tag() const
+    { return m_tag ? m_tag->clone() : 0; }
+
+    virtual StanzaExtension* clone() const
+    { return new SEFilterTest( extensionType(), m_filter, m_tag ); }
+
+    const Tag* source() const { return m_tag; }
+
+  private:
+    std::string m_filter;
+    const Tag* m_tag;
+
+};
+
+static int countExtensions( const Stanza& stanza, int type )
+{
+  int n = 0;
+  StanzaExtensionList::const_iterator it = stanza.extensions().begin();
+  for( ; it != stanza.extensions().end(); ++it )
+    if( (*it)->extensionType() == type )
+      ++n;
+  return n;
+}
+
 int main( int /*argc*/, char** /*argv*/ )
 {
   int fail = 0;
@@ -66,6 +102,77 @@ int main( int /*argc*/, char** /*argv*/ )
   }
 
 
+  // -------
+  {
+    name = "indexed and XPath filters";
+    StanzaExtensionFactory sef2;
+    sef2.registerExtension( new SEFilterTest( ExtUser + 2, "/iq/x[@xmlns='a']|/iq/y" ) );
+    sef2.registerExtension( new SEFilterTest( ExtUser + 3, "/iq/z/w" ) );
+    sef2.registerExtension( new SEFilterTest( ExtUser + 4, "/iq/x|/iq/x[@xmlns='a']" ) );
+    sef2.registerExtension( new SEFilterTest( ExtUser + 5, "/message/x[@xmlns='a']" ) );
+    Tag* i = new Tag( "iq" );
+    Tag* x1 = new Tag( i, "x", "xmlns", "a" );
+    new Tag( i, "x", "xmlns", "b" );
+    new Tag( i, "y", "xmlns", "c" );
+    Tag* z = new Tag( i, "z" );
+    Tag* w = new Tag( z, "w" );
+    IQ iq( IQ::Set, JID(), "" );
+    sef2.addExtensions( iq, i );
+    const SEFilterTest* x = iq.findExtension<SEFilterTest>( ExtUser + 2 );
+    const SEFilterTest* ww = iq.findExtension<SEFilterTest>( ExtUser + 3 );
+    if( countExtensions( iq, ExtUser + 2 ) != 2 || !x || x->source() != x1
+        || countExtensions( iq, ExtUser + 3 ) != 1 || !ww || ww->source() != w
+        || countExtensions( iq, ExtUser + 4 ) != 2 || countExtensions( iq, ExtUser + 5 ) != 0 )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+    delete i;
+  }
+
+  // -------
+  {
+    name = "extensions are added in registration order";
+    StanzaExtensionFactory sef2;
+    sef2.registerExtension( new SEFilterTest( ExtUser + 2, "/iq/b" ) );
+    sef2.registerExtension( new SEFilterTest( ExtUser + 3, "/iq/*[@xmlns='c']" ) );
+    sef2.registerExtension( new SEFilterTest( ExtUser + 4, "/iq/a" ) );
+    Tag* i = new Tag( "iq" );
+    new Tag( i, "a" );
+    new Tag( i, "c", "xmlns", "c" );
+    new Tag( i, "b" );
+    IQ iq( IQ::Set, JID(), "" );
+    sef2.addExtensions( iq, i );
+    const StanzaExtensionList& l = iq.extensions();
+    StanzaExtensionList::const_iterator it = l.begin();
+    if( l.size() != 3 || (*it)->extensionType() != ExtUser + 2
+        || (*++it)->extensionType() != ExtUser + 3 || (*++it)->extensionType() != ExtUser + 4 )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+    delete i;
+  }
+
+  // -------
+  {
+    name = "removed ext is no longer matched";
+    StanzaExtensionFactory sef2;
+    sef2.registerExtension( new SEFilterTest( ExtUser + 2, "/iq/a" ) );
+    sef2.registerExtension( new SEFilterTest( ExtUser + 3, "/iq/a" ) );
+    sef2.removeExtension( ExtUser + 2 );
+    Tag* i = new Tag( "iq" );
+    new Tag( i, "a" );
+    IQ iq( IQ::Set, JID(), "" );
+    sef2.addExtensions( iq, i );
+    if( iq.extensions().size() != 1 || iq.extensions().front()->extensionType() != ExtUser + 3 )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+    delete i;
+  }
+
   if( fail == 0 )
   {
     printf( "StanzaExtensionFactory: OK\n" );
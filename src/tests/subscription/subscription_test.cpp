@@ -149,6 +149,25 @@ int main( int /*argc*/, char** /*argv*/ )
     delete i;
   }
 
+  // -------
+  {
+    name = "appendXml()";
+    Subscription s( Subscription::Subscribe, JID( "xyz@example.org/blah" ), "the status",
+                    "the xmllang" );
+    Subscription e( Subscription::Unsubscribe, JID( "xyz@example.org" ) );
+    std::string out;
+    s.appendXml( out );
+    e.appendXml( out, "me@example.net", "jabber:client" );
+    Tag* i = s.tag();
+    if( out != i->xml() + "<presence to='xyz@example.org' type='unsubscribe' from='me@example.net' "
+                          "xmlns='jabber:client'/>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), out.c_str() );
+    }
+    delete i;
+  }
+
 
 
 
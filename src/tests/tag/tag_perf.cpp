@@ -94,6 +94,21 @@ int main( int /*argc*/, char** /*argv*/ )
   printTime ("escaping xml", tv1, tv2);
 
 
+  // ---------------------------------------------------------------------
+
+  tag = newSimpleTag();
+  std::string buffer;
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    buffer.clear();
+    tag->appendXml( buffer );
+  }
+  gettimeofday( &tv2, 0 );
+  delete tag;
+  printTime ("non escaping appendXml (re-used buffer)", tv1, tv2);
+
+
   // ---------------------------------------------------------------------
 
   gettimeofday( &tv1, 0 );
@@ -140,6 +155,23 @@ int main( int /*argc*/, char** /*argv*/ )
   gettimeofday( &tv2, 0 );
   printTime ("clone/delete", tv1, tv2);
 
+  // -----------------------------------------------------------------------
+
+  Tag* wide = new Tag( "query" );
+  for( int i = 0; i < 10000; ++i )
+    new Tag( wide, "item", "jid", "user@example.net" );
+  new Tag( wide, "set", "xmlns", "http://jabber.org/protocol/rsm" );
+
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    wide->findChild( "set" );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime ("findChild() on 10000 children", tv1, tv2);
+
+  delete wide;
+
 
 
 
@@ -1,4 +1,5 @@
 #include "../../tag.h"
+#include "../../tagarena.h"
 #include "../../util.h"
 using namespace gloox;
 
@@ -414,7 +415,457 @@ int main( int /*argc*/, char** /*argv*/ )
   }
 
 
+  // -------
+  {
+    name = "appendXml()";
+    Tag* m = new Tag( "message", "to", "a'b<c" );
+    m->setXmlns( "ns" );
+    Tag* b = new Tag( m, "body", "x & y" );
+    b->setPrefix( "p" );
+    new Tag( m, "empty" );
+    std::string out = "<stream>";
+    m->appendXml( out );
+    if( out != "<stream>" + m->xml()
+        || m->xml() != "<message to='a&apos;b&lt;c' xmlns='ns'><p:body>x &amp; y</p:body>"
+                       "<empty/></message>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), out.c_str() );
+    }
+    delete m;
+  }
+
+  // -------
+  {
+    name = "atoms";
+    Atom a1( "message" );
+    Atom a2( std::string( "mess" ) + "age" );
+    Atom a3( "some-unknown-name" );
+    Atom a4( a3 );
+    if( !a1.shared() || a3.shared() || !( a1 == a2 ) || a1 == a3 || !( a3 == a4 )
+        || a1.str() != "message" || a4.str() != "some-unknown-name" || !Atom().empty() )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  {
+    name = "lookups with well-known and unknown names";
+    Tag* m = new Tag( "message", "to", "foo@bar" );
+    m->addAttribute( "some-unknown-attr", "v" );
+    new Tag( m, "body", "text" );
+    new Tag( m, "some-unknown-child" );
+    if( m->findAttribute( "to" ) != "foo@bar" || m->findAttribute( "some-unknown-attr" ) != "v"
+        || !m->hasAttribute( "some-unknown-attr", "v" ) || m->hasAttribute( "from" )
+        || !m->findChild( "body" ) || !m->findChild( "some-unknown-child" )
+        || m->findChild( "subject" ) || m->findChild( "some-other-child" )
+        || m->findChildren( "body" ).size() != 1 )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+    delete m;
+  }
+
+  // -------
+  {
+    name = "lookups on many children";
+    Tag* m = new Tag( "query" );
+    char buf[16];
+    for( int i = 0; i < 200; ++i )
+    {
+      sprintf( buf, "item%d", i % 50 );
+      new Tag( m, buf, "n", std::string( buf + 4 ) + ( i < 50 ? "a" : "b" ) );
+    }
+    new Tag( m, "set", "xmlns", "rsm" );
+    Tag* c = m->findChild( "item7" );
+    if( !c || c->findAttribute( "n" ) != "7a" || m->findChildren( "item7" ).size() != 4
+        || !m->hasChild( "item7", "n", "7b" ) || m->findChild( "item" ) || m->findChild( "item50" )
+        || m->findChildren( "set", "rsm" ).size() != 1 || !m->findChildren( "set", "x" ).empty() )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+    m->removeChild( c );
+    delete c;
+    new Tag( m, "item7", "n", "7c" );
+    new Tag( m, "item50", "n", "50" );
+    m->removeChild( "set" );
+    TagList l = m->findChildren( "item7" );
+    if( l.size() != 4 || l.front()->findAttribute( "n" ) != "7b" || l.back()->findAttribute( "n" ) != "7c"
+        || !m->findChild( "item50" ) || m->findChild( "set" ) )
+    {
+      ++fail;
+      printf( "test '%s' failed: after changes\n", name.c_str() );
+    }
+    Tag* s = m->share();
+    if( !s->hasChild( "item50", "n", "50" ) || !s->findChild( "item49" )
+        || s->findChild( "item49" ) != m->findChild( "item49" ) )
+    {
+      ++fail;
+      printf( "test '%s' failed: shared\n", name.c_str() );
+    }
+    delete s;
+    delete m;
+  }
+
+  // -------
+  {
+    name = "lookups with C strings and std::strings";
+    Tag* m = new Tag( "message", "some-unknown-attr", "v" );
+    new Tag( m, "body", "text" );
+    new Tag( m, "x", "xmlns", "some:ns" );
+    const std::string unknown( "some-unknown-attr" );
+    const std::string prefix( "some-unknown" );
+    if( m->findAttribute( unknown ) != "v" || !m->findAttribute( prefix ).empty()
+        || !m->findAttribute( "some-unknown" ).empty() || !m->hasAttribute( "some-unknown-attr" )
+        || !m->hasAttribute( unknown, std::string( "v" ) ) || m->hasAttribute( "some-unknown-attr", "w" )
+        || m->hasAttribute( "" ) || m->findChild( "bod" )
+        || m->findChild( std::string( "body" ) ) != m->findChild( "body" )
+        || !m->hasChild( "x", "xmlns", "some:ns" ) || m->hasChild( "x", "xmlns", "other:ns" )
+        || m->findChild( "x", EmptyString ) || !m->hasChild( "x" )
+        || m->findChildren( "x", "some:ns" ).size() != 1 || !m->findChildren( "x", "other:ns" ).empty() )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+    delete m;
+  }
+
+  // -------
+  {
+    name = "arena-allocated tree";
+    TagArena arena( 256 );
+    Tag* a = new( &arena ) Tag( "aaa" );
+    new Tag( a, "heap", "attr", "value" );
+    Tag* b = new( &arena ) Tag( a, "arena" );
+    b->addAttribute( new( &arena ) Tag::Attribute( "foo", "bar" ) );
+    Tag* k = a->clone();
+    if( a->xml() != "<aaa><heap attr='value'/><arena foo='bar'/></aaa>" || *a != *k
+        || arena.allocated() == 0 )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), a->xml().c_str() );
+    }
+    delete a;
+    arena.reset();
+    if( arena.allocated() != 0 || k->xml() != "<aaa><heap attr='value'/><arena foo='bar'/></aaa>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), k->xml().c_str() );
+    }
+    delete k;
+  }
+
+  // -------
+  {
+    name = "many children and attributes";
+    Tag* m = new Tag( "m" );
+    std::string expected = "<m";
+    for( int i = 0; i < 10; ++i )
+    {
+      m->addAttribute( "a" + util::int2string( i ), i + 1 );
+      expected += " a" + util::int2string( i ) + "='" + util::int2string( i + 1 ) + "'";
+    }
+    expected += ">";
+    for( int i = 0; i < 10; ++i )
+    {
+      new Tag( m, "c" + util::int2string( i ) );
+      m->addCData( util::int2string( i ) );
+      expected += "<c" + util::int2string( i ) + "/>" + util::int2string( i );
+    }
+    expected += "</m>";
+    Tag* k = m->clone();
+    if( m->xml() != expected || *m != *k || m->children().size() != 10
+        || m->attributes().size() != 10 || m->cdata() != "0123456789"
+        || m->findAttribute( "a9" ) != "10" || !m->findChild( "c9" ) )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), m->xml().c_str() );
+    }
+    delete m;
+    delete k;
+  }
+
+  // -------
+  {
+    name = "children() and attributes() follow changes";
+    Tag* m = new Tag( "m", "a", "b" );
+    Tag* c1 = new Tag( m, "c1" );
+    const TagList& children = m->children();
+    const Tag::AttributeList& attributes = m->attributes();
+    Tag* c2 = new Tag( m, "c2" );
+    m->addAttribute( "c", "d" );
+    m->addAttribute( "a", "e" );
+    m->removeChild( c1 );
+    if( children.size() != 1 || children.front() != c2 || attributes.size() != 2
+        || attributes.front()->value() != "e" || attributes.back()->name() != "c" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), m->xml().c_str() );
+    }
+    m->removeChild( "c2" );
+    m->removeAttribute( "a" );
+    if( !children.empty() || attributes.size() != 1 || m->xml() != "<m c='d'/>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), m->xml().c_str() );
+    }
+    delete c1;
+    delete m;
+  }
+
+  // -------
+  {
+    name = "setCData() with child elements";
+    Tag* m = new Tag( "m", "x" );
+    new Tag( m, "c" );
+    m->addCData( "y" );
+    m->setCData( "z" );
+    if( m->cdata() != "z" || m->xml() != "<m><c/>z</m>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), m->xml().c_str() );
+    }
+    delete m;
+  }
+
+  // -------
+  {
+    name = "share()";
+    Tag* m = new Tag( "payload", "xmlns", "ns" );
+    new Tag( m, "entry", "a & b" );
+    const std::string xml = m->xml();
+    Tag* s1 = m->share();
+    Tag* s2 = s1->clone();
+    if( m->xml() != xml || s1->xml() != xml || s2->xml() != xml || *s1 != *m
+        || s2->xmlns() != "ns" || !s2->hasChild( "entry" ) || s2->cdata() != "" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), s2->xml().c_str() );
+    }
+    const Tag* entry = s1->findChild( "entry" );
+    if( !entry || entry != m->findChild( "entry" ) || s1->children().size() != 1 )
+    {
+      ++fail;
+      printf( "test '%s' failed: shared children expected\n", name.c_str() );
+    }
+    s1->addAttribute( "foo", "bar" );
+    s1->findChild( "entry" )->setCData( "changed" );
+    delete m;
+    if( s1->xml() != "<payload xmlns='ns' foo='bar'><entry>changed</entry></payload>"
+        || s2->xml() != xml || s1->findChild( "entry" )->parent() != s1 )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s %s\n", name.c_str(), s1->xml().c_str(), s2->xml().c_str() );
+    }
+    delete s1;
+    delete s2;
+  }
+
+  // -------
+  {
+    name = "share() and the last copy";
+    Tag* m = new Tag( "m" );
+    Tag* c = new Tag( m, "c" );
+    Tag* s1 = m->share();
+    delete s1;
+    Tag* c2 = m->findChild( "c" );
+    if( c2 != c || c->parent() != m || m->children().size() != 1 || m->xml() != "<m><c/></m>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), m->xml().c_str() );
+    }
+    Tag* s2 = m->share();
+    Tag* outer = new Tag( "outer" );
+    outer->addChild( s2 );
+    if( outer->xml() != "<outer><m><c/></m></outer>" || !outer->findChild( "m" )->hasChild( "c" ) )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), outer->xml().c_str() );
+    }
+    delete outer;
+    delete m;
+  }
+
+  // -------
+  {
+    name = "share(): children keep their parent";
+    Tag* m = new Tag( "m" );
+    Tag* c = new Tag( m, "c" );
+    Tag* d = new Tag( c, "d" );
+    Tag* s1 = m->share();
+    if( c->parent() != m || d->findTag( ".." ) != c || c->findTag( ".." ) != m
+        || c->findTag( "/m" ) != m )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+    m->addAttribute( "x", "y" );
+    if( m->findChild( "c" ) != c || c->parent() != m || s1->xml() != "<m><c><d/></c></m>"
+        || m->xml() != "<m x='y'><c><d/></c></m>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s %s\n", name.c_str(), m->xml().c_str(), s1->xml().c_str() );
+    }
+    delete m;
+    if( s1->xml() != "<m><c><d/></c></m>" || !s1->findChild( "c" )
+        || s1->findChild( "c" )->parent() == m )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), s1->xml().c_str() );
+    }
+    delete s1;
+  }
+
+  // -------
+  {
+    name = "clone() of a shared Tag";
+    Tag* m = new Tag( "m", "xmlns", "ns" );
+    Tag* c = new Tag( m, "c" );
+    Tag* s1 = m->share();
+    Tag* s2 = s1->clone();
+    if( s2->xml() != "<m xmlns='ns'><c/></m>" || s2->findChild( "c" ) == c
+        || s2->findChild( "c" )->parent() != s2 || s1->findChild( "c" ) != c )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), s2->xml().c_str() );
+    }
+    delete m;
+    delete s1;
+    delete s2;
+  }
+
+  // -------
+  {
+    name = "cloneShared()";
+    Tag* m = new Tag( "m", "xmlns", "ns" );
+    Tag* c = new Tag( m, "c", "a & b" );
+    Tag* p = m->cloneShared();
+    Tag* s = p->share();
+    Tag* outer = new Tag( "outer" );
+    outer->addChildCopy( s );
+    if( p->xml() != m->xml() || s->xml() != m->xml() || !s->findChild( "c" )
+        || s->findChild( "c" ) != p->findChild( "c" ) || s->findChild( "c" ) == c
+        || c->parent() != m || outer->findChild( "m" )->findChild( "c" ) != p->findChild( "c" ) )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), s->xml().c_str() );
+    }
+    delete p;
+    s->findChild( "c" );
+    s->addAttribute( "x", "y" );
+    s->findChild( "c" )->setCData( "d" );
+    if( s->xml() != "<m xmlns='ns' x='y'><c>d</c></m>"
+        || outer->xml() != "<outer><m xmlns='ns'><c>a &amp; b</c></m></outer>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s %s\n", name.c_str(), s->xml().c_str(), outer->xml().c_str() );
+    }
+    delete s;
+    delete outer;
+    delete m;
+  }
+
+  // -------
+  {
+    name = "comparing shared Tags";
+    Tag* a = new Tag( "a", "x", "1" );
+    Tag* b = new Tag( "a", "x", "2" );
+    Tag* s1 = a->share();
+    if( *a == *b || *b == *a || *s1 == *b || !( *s1 == *a ) )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+    delete s1;
+    delete a;
+    delete b;
+  }
 
+  // -------
+  {
+    name = "setXmlCaching()";
+    Tag* m = new Tag( "m", "xmlns", "ns" );
+    Tag* c = new Tag( m, "c", "a", "b" );
+    new Tag( m, "d" );
+    m->setXmlCaching( true );
+    c->setXmlCaching( true );
+    if( m->xml() != "<m xmlns='ns'><c a='b'/><d/></m>" || m->xml() != m->xml() )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), m->xml().c_str() );
+    }
+    m->findChild( "c" )->addAttribute( "x", "y" );
+    if( m->xml() != "<m xmlns='ns'><c a='b' x='y'/><d/></m>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), m->xml().c_str() );
+    }
+    c->attributes().front()->setValue( "z" );
+    m->findChild( "d" )->setCData( "e" );
+    if( m->xml() != "<m xmlns='ns'><c a='z' x='y'/><d>e</d></m>"
+        || c->xml() != "<c a='z' x='y'/>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), m->xml().c_str() );
+    }
+    m->removeChild( c );
+    delete c;
+    m->setPrefix( "p" );
+    if( m->xml() != "<p:m xmlns='ns'><d>e</d></p:m>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), m->xml().c_str() );
+    }
+    m->setXmlCaching( false );
+    m->findChild( "d" )->setCData( "f" );
+    if( m->xml() != "<p:m xmlns='ns'><d>f</d></p:m>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), m->xml().c_str() );
+    }
+    delete m;
+  }
+
+  // -------
+  {
+    name = "modifying a removed child";
+    Tag* m = new Tag( "m" );
+    Tag* c = new Tag( m, "c" );
+    m->setXmlCaching( true );
+    m->xml();
+    m->removeChild( c );
+    delete m;
+    c->addAttribute( "a", "b" );
+    if( c->parent() || c->xml() != "<c a='b'/>" )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s\n", name.c_str(), c->xml().c_str() );
+    }
+    delete c;
+  }
+
+  // -------
+  {
+    name = "serializing shared contents";
+    Tag* m = new Tag( "m", "a", "b" );
+    new Tag( m, "c", "text" );
+    Tag* s1 = m->share();
+    Tag* s2 = m->clone();
+    s2->setPrefix( "p" );
+    if( s1->xml() != "<m a='b'><c>text</c></m>" || s2->xml() != "<p:m a='b'><c>text</c></p:m>"
+        || m->xml() != s1->xml() )
+    {
+      ++fail;
+      printf( "test '%s' failed: %s %s\n", name.c_str(), s1->xml().c_str(), s2->xml().c_str() );
+    }
+    delete m;
+    delete s1;
+    delete s2;
+  }
 
   delete t;
   t = 0;
@@ -173,6 +173,34 @@ int main()
     ++fail;
   }
 
+  // -------
+  name = "lookup table";
+  static const char* values3[] = { "chat", "", "error", "groupchat", "chat", "", "headline",
+                                   "normal", "available", "unavailable", "probe", "subscribe",
+                                   "subscribed", "unsubscribe", "unsubscribed", "get", "set" };
+  const util::LookupTable table( values3 );
+  bool tfail = false;
+  for( unsigned i = 0; i < sizeof( values3 ) / sizeof( char* ); ++i )
+  {
+    if( table.find( values3[i] ) != util::lookup( values3[i], values3 ) )
+      tfail = true;
+  }
+  if( tfail || table.find( "foo" ) != 17 || table.find( "foo", B ) != B || table.find( "cha" ) != 17
+      || table.find( "chat" ) != 0 || table.find( "" ) != 1 )
+  {
+    printf( "test '%s' failed\n", name.c_str() );
+    ++fail;
+  }
+
+  // -------
+  name = "lookup table (ORable)";
+  const util::LookupTable table2( values2 );
+  if( table2.find2( "e" ) != E || table2.find2( "x" ) != Inval2 || table2.find2( "x", F ) != F )
+  {
+    printf( "test '%s' failed\n", name.c_str() );
+    ++fail;
+  }
+
   // -------
   name = "long2string 1";
   int ex = 2147483647;
@@ -254,6 +282,75 @@ int main()
   }
 
 
+  // -------
+  name = "findFirstOf";
+  std::string buf( 100, 'x' );
+  int pos = 0;
+  for( ; pos < 100; ++pos )
+  {
+    buf[pos] = '&';
+    if( util::findFirstOf( buf.data(), buf.length(), "<&", 2 ) != (std::string::size_type)pos )
+      break;
+    buf[pos] = 'x';
+  }
+  if( pos != 100 || util::findFirstOf( buf.data(), buf.length(), "<&", 2 ) != buf.length() )
+  {
+    printf( "test '%s' failed at pos %d\n", name.c_str(), pos );
+    ++fail;
+  }
+
+  // -------
+  name = "findFirstOf with empty input";
+  if( util::findFirstOf( buf.data(), 0, "x", 1 ) != 0 )
+  {
+    printf( "test '%s' failed\n", name.c_str() );
+    ++fail;
+  }
+
+  // -------
+  name = "appendEscaped";
+  std::string escaped = "x";
+  util::appendEscaped( escaped, "a&b<c>d'e\"f" );
+  if( escaped != "xa&amp;b&lt;c&gt;d&apos;e&quot;f" )
+  {
+    printf( "test '%s' failed: %s\n", name.c_str(), escaped.c_str() );
+    ++fail;
+  }
+
+  // -------
+  name = "escape";
+  if( util::escape( "" ) != "" || util::escape( buf ) != buf
+      || util::escape( "<a href='x'>&\"</a>" ) != "&lt;a href=&apos;x&apos;&gt;&amp;&quot;&lt;/a&gt;" )
+  {
+    printf( "test '%s' failed\n", name.c_str() );
+    ++fail;
+  }
+
+  // -------
+  name = "escape long input";
+  std::string raw;
+  std::string expected;
+  for( int i = 0; i < 300; ++i )
+  {
+    const char c = "ab<cdefghijklmnopqr&stuvwxyz0123>456789'ABCDEFG\"HIJ"[i % 52];
+    raw += c;
+    switch( c )
+    {
+      case '&': expected += "&amp;"; break;
+      case '<': expected += "&lt;"; break;
+      case '>': expected += "&gt;"; break;
+      case '\'': expected += "&apos;"; break;
+      case '"': expected += "&quot;"; break;
+      default: expected += c; break;
+    }
+  }
+  if( util::escape( raw ) != expected )
+  {
+    printf( "test '%s' failed\n", name.c_str() );
+    ++fail;
+  }
+
+
 
 
   if( fail == 0 )
@@ -80,6 +80,21 @@ int main( int /*argc*/, char** /*argv*/ )
   d = 0;
   t = 0;
 
+  // -------
+  name = "appendXml()";
+  d = new VCardUpdate( x );
+  t = d->tag();
+  std::string out;
+  d->appendXml( out );
+  if( out != t->xml() )
+  {
+    ++fail;
+    printf( "test '%s' failed: %s\n", name.c_str(), out.c_str() );
+  }
+  delete d;
+  delete t;
+  d = 0;
+  t = 0;
 
 
 
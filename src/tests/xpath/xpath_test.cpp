@@ -1,4 +1,5 @@
 #include "../../tag.h"
+#include "../../compiledxpath.h"
 using namespace gloox;
 
 #include <stdio.h>
@@ -926,6 +927,73 @@ int main( int /*argc*/, char** /*argv*/ )
 
 
 
+  // -- compiled expressions --
+
+  // -------
+  name = "compiled expression, evaluated repeatedly: //ggg/..";
+  {
+    CompiledXPath xp( "//ggg/.." );
+    result = aaa->findTagList( xp );
+    ConstTagList result2 = aaa->findTagList( xp );
+    if( xp.expression() != "//ggg/.." || result.size() != 1 || result.front() != fff
+        || result2 != result || aaa->findTag( xp ) != fff )
+    {
+      ++fail;
+      printResult( name, result );
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  name = "compiled expression matches string expression: //bbb[@name='b1']|//hhh[@name='h1']";
+  {
+    CompiledXPath xp( "//bbb[@name='b1']|//hhh[@name='h1']" );
+    result = aaa->findTagList( xp );
+    if( result.empty() || result != aaa->findTagList( "//bbb[@name='b1']|//hhh[@name='h1']" )
+        || result != aaa->findTagList( "//bbb[@name='b1']|//hhh[@name='h1']" ) )
+    {
+      ++fail;
+      printResult( name, result );
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  name = "compiled absolute expression from child: /*/../*";
+  {
+    CompiledXPath xp( "/*/../*" );
+    result = fff->findTagList( xp );
+    if( result != aaa->findTagList( xp ) || result != aaa->findTagList( "/*/../*" ) )
+    {
+      ++fail;
+      printResult( name, result );
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  name = "cached expression";
+  {
+    const CompiledXPath* xp = CompiledXPath::cached( "/aaa/bbb" );
+    if( !xp || xp != CompiledXPath::cached( "/aaa/bbb" ) || xp->expression() != "/aaa/bbb"
+        || aaa->findTagList( *xp ) != aaa->findTagList( "/aaa/bbb" ) )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  name = "compiled root-only expression: /";
+  {
+    CompiledXPath xp( "/" );
+    if( !aaa->findTagList( xp ).empty() || aaa->findTag( xp ) )
+    {
+      ++fail;
+      printf( "test '%s' failed\n", name.c_str() );
+    }
+  }
+
   delete aaa;
 
   if( fail == 0 )
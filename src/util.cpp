@@ -13,6 +13,20 @@
 #include "util.h"
 #include "gloox.h"
 
+#include <cstring>
+
+#if defined( __AVX2__ )
+# include <immintrin.h>
+# define GLOOX_SCAN_AVX2
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+# include <emmintrin.h>
+# define GLOOX_SCAN_SSE2
+#endif
+
+#if defined( _MSC_VER ) && ( defined( GLOOX_SCAN_AVX2 ) || defined( GLOOX_SCAN_SSE2 ) )
+# include <intrin.h>
+#endif
+
 namespace gloox
 {
 
@@ -55,28 +69,190 @@ namespace gloox
       return i < size ? std::string( values[i] ) : def;
     }
 
+    void LookupTable::init( const char* values[], unsigned size )
+    {
+      m_values = values;
+      m_size = size;
+      m_lengths.resize( size );
+      for( unsigned i = 0; i < size; ++i )
+        m_lengths[i] = std::strlen( values[i] );
+
+      // try seeds until every distinct string gets a slot of its own, growing the table
+      // if that takes too long. duplicates keep their first index, like _lookup() does.
+      unsigned slots = 4;
+      while( slots < 2 * size )
+        slots <<= 1;
+
+      for( m_seed = 0; ; ++m_seed )
+      {
+        if( m_seed && !( m_seed % 64 ) )
+          slots <<= 1;
+
+        m_mask = slots - 1;
+        m_slots.assign( slots, size );
+
+        unsigned i = 0;
+        for( ; i < size; ++i )
+        {
+          unsigned& slot = m_slots[hash( values[i], m_lengths[i], m_seed ) & m_mask];
+          if( slot == size )
+            slot = i;
+          else if( m_lengths[slot] != m_lengths[i] || std::strcmp( values[slot], values[i] ) )
+            break;
+        }
+
+        if( i == size )
+          return;
+      }
+    }
+
+    unsigned LookupTable::find2( const std::string& str, int def ) const
+    {
+      return 1 << find( str, def <= 0 ? def : (int)internalLog2( def ) );
+    }
+
+#if defined( GLOOX_SCAN_AVX2 ) || defined( GLOOX_SCAN_SSE2 )
+    static inline unsigned lowestBit( unsigned mask )
+    {
+#if defined( __GNUC__ )
+      return (unsigned)__builtin_ctz( mask );
+#elif defined( _MSC_VER )
+      unsigned long idx;
+      _BitScanForward( &idx, mask );
+      return (unsigned)idx;
+#else
+      unsigned idx = 0;
+      while( !( mask & 1 ) )
+      {
+        mask >>= 1;
+        ++idx;
+      }
+      return idx;
+#endif
+    }
+#endif
+
+    std::string::size_type findFirstOf( const char* data, std::string::size_type length,
+                                        const char* stops, unsigned numStops )
+    {
+      std::string::size_type i = 0;
+
+#if defined( GLOOX_SCAN_AVX2 )
+      for( ; i + 32 <= length; i += 32 )
+      {
+        const __m256i block = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + i ) );
+        __m256i hits = _mm256_setzero_si256();
+        for( unsigned s = 0; s < numStops; ++s )
+          hits = _mm256_or_si256( hits, _mm256_cmpeq_epi8( block, _mm256_set1_epi8( stops[s] ) ) );
+        const unsigned mask = (unsigned)_mm256_movemask_epi8( hits );
+        if( mask )
+          return i + lowestBit( mask );
+      }
+#endif
+#if defined( GLOOX_SCAN_AVX2 ) || defined( GLOOX_SCAN_SSE2 )
+      for( ; i + 16 <= length; i += 16 )
+      {
+        const __m128i block = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + i ) );
+        __m128i hits = _mm_setzero_si128();
+        for( unsigned s = 0; s < numStops; ++s )
+          hits = _mm_or_si128( hits, _mm_cmpeq_epi8( block, _mm_set1_epi8( stops[s] ) ) );
+        const unsigned mask = (unsigned)_mm_movemask_epi8( hits );
+        if( mask )
+          return i + lowestBit( mask );
+      }
+#endif
+
+      for( ; i < length; ++i )
+      {
+        for( unsigned s = 0; s < numStops; ++s )
+        {
+          if( data[i] == stops[s] )
+            return i;
+        }
+      }
+      return length;
+    }
+
     static const char escape_chars[] = { '&', '<', '>', '\'', '"' };
 
     static const std::string escape_seqs[] = { "amp;", "lt;", "gt;", "apos;", "quot;" };
 
     static const unsigned escape_size = 5;
 
-    const std::string escape( std::string what )
+    // returns 1 + the index into escape_seqs, or 0 if c needs no escaping
+    static inline unsigned escapeIndex( char c )
+    {
+      switch( c )
+      {
+        case '&':  return 1;
+        case '<':  return 2;
+        case '>':  return 3;
+        case '\'': return 4;
+        case '"':  return 5;
+        default:   return 0;
+      }
+    }
+
+    const std::string escape( const std::string& what )
+    {
+      if( findFirstOf( what.data(), what.length(), escape_chars, escape_size ) == what.length() )
+        return what;
+
+      std::string escaped;
+      appendEscaped( escaped, what );
+      return escaped;
+    }
+
+    void appendEscaped( std::string& target, const std::string& what )
     {
-      for( size_t val, i = 0; i < what.length(); ++i )
+      const char* data = what.data();
+      const std::string::size_type length = what.length();
+      const std::string::size_type first = findFirstOf( data, length, escape_chars, escape_size );
+      if( first == length )
+      {
+        target += what;
+        return;
+      }
+
+      std::string::size_type size = length;
+      for( std::string::size_type i = first; i < length; ++i )
+      {
+        const unsigned idx = escapeIndex( data[i] );
+        if( idx )
+          size += escape_seqs[idx - 1].length();
+      }
+
+      const std::string::size_type offset = target.length();
+      target.resize( offset + size );
+      char* out = &target[offset];
+      memcpy( out, data, first );
+      out += first;
+      for( std::string::size_type i = first; i < length; ++i )
       {
-        for( val = 0; val < escape_size; ++val )
+        const unsigned idx = escapeIndex( data[i] );
+        if( !idx )
         {
-          if( what[i] == escape_chars[val] )
-          {
-            what[i] = '&';
-            what.insert( i+1, escape_seqs[val] );
-            i += escape_seqs[val].length();
-            break;
-          }
+          *out++ = data[i];
+          continue;
         }
+
+        const std::string& seq = escape_seqs[idx - 1];
+        *out++ = '&';
+        memcpy( out, seq.data(), seq.length() );
+        out += seq.length();
       }
-      return what;
+    }
+
+    void appendAttribute( std::string& target, const char* name, const std::string& value )
+    {
+      if( value.empty() || !checkValidXMLChars( value ) )
+        return;
+
+      target += ' ';
+      target += name;
+      target += "='";
+      appendEscaped( target, value );
+      target += '\'';
     }
 
     bool checkValidXMLChars( const std::string& data )
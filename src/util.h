@@ -20,6 +20,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 
 namespace gloox
 {
@@ -79,6 +80,80 @@ namespace gloox
     GLOOX_API const std::string _lookup2( unsigned code, const char* values[],
                                 unsigned size, const std::string& def = EmptyString );
 
+    /**
+     * @brief A table for the string-to-code direction of lookup() and lookup2().
+     *
+     * The table is built once from the same array of strings that is passed to lookup().
+     * Building it picks a hash function that maps every distinct string of the array to its
+     * own slot, so that finding a string costs one hash and one comparison, independent of
+     * the array's size. Results are the same as those of lookup() and lookup2(),
+     * respectively.
+     *
+     * Tables are usually defined next to the array:
+     * @code
+     * static const char* typeValues[] = { "get", "set", "result", "error" };
+     * static const util::LookupTable typeTable( typeValues );
+     * ...
+     * type = (IqType)typeTable.find( tag->findAttribute( TYPE ) );
+     * @endcode
+     *
+     * @since 1.0
+     */
+    class GLOOX_API LookupTable
+    {
+      public:
+        /**
+         * Builds a table from the given array of strings. The array must outlive the table.
+         * @param values The array of strings, as passed to lookup().
+         */
+        template< unsigned N >
+        LookupTable( const char* (&values)[N] ) { init( values, N ); }
+
+        /**
+         * Finds the enumerated value associated with a string value, like lookup() does.
+         * @param str String to search for.
+         * @param def Default value returned in case the lookup failed.
+         * @return The associated enum code. If there is none, @c def, or the array's size
+         * if @c def is negative.
+         */
+        unsigned find( const std::string& str, int def = -1 ) const
+        {
+          const unsigned i = m_slots[hash( str.data(), str.length(), m_seed ) & m_mask];
+          if( i < m_size && m_lengths[i] == str.length()
+              && !str.compare( 0, std::string::npos, m_values[i], m_lengths[i] ) )
+            return i;
+
+          return def >= 0 ? (unsigned)def : m_size;
+        }
+
+        /**
+         * Finds the ORable enumerated value associated with a string value, like lookup2()
+         * does.
+         * @param str String to search for.
+         * @param def The default value to return if the lookup failed.
+         * @return The associated enum code.
+         */
+        unsigned find2( const std::string& str, int def = -1 ) const;
+
+      private:
+        static unsigned hash( const char* data, std::string::size_type length, unsigned seed )
+        {
+          unsigned h = 2166136261u ^ seed;
+          for( std::string::size_type i = 0; i < length; ++i )
+            h = ( h ^ (unsigned char)data[i] ) * 16777619u;
+          return h;
+        }
+
+        void init( const char* values[], unsigned size );
+
+        const char** m_values;
+        unsigned m_size;
+        unsigned m_mask;
+        unsigned m_seed;
+        std::vector<unsigned> m_slots;                  // index into m_values, m_size if empty
+        std::vector<std::string::size_type> m_lengths;
+    };
+
     /**
      * A convenience function that executes the given function on each object in a given list.
      * @param t The object to execute the function on.
@@ -188,12 +263,47 @@ namespace gloox
       }
     }
 
+    /**
+     * Finds the first occurence of any of the given bytes in a buffer. If the library
+     * is compiled with SSE2 or AVX2 enabled, 16 or 32 bytes are examined at a time.
+     * @param data The buffer to scan.
+     * @param length The number of bytes available at @c data.
+     * @param stops The bytes to look for.
+     * @param numStops The number of bytes in @c stops.
+     * @return The offset of the first match, or @c length if there is none.
+     * @since 1.0
+     */
+    GLOOX_API std::string::size_type findFirstOf( const char* data, std::string::size_type length,
+                                                  const char* stops, unsigned numStops );
+
     /**
      * Does some fancy escaping. (& --> &amp;, etc).
      * @param what A string to escape.
      * @return The escaped string.
      */
-    GLOOX_API const std::string escape( std::string what );
+    GLOOX_API const std::string escape( const std::string& what );
+
+    /**
+     * Escapes the given string like escape() does and appends the result to @c target.
+     * Input that doesn't need escaping is appended as a whole. Otherwise, @c target is
+     * grown once to the final size before the escaped text is written.
+     * @param target The string to append to.
+     * @param what The string to escape.
+     * @since 1.0
+     */
+    GLOOX_API void appendEscaped( std::string& target, const std::string& what );
+
+    /**
+     * Appends an attribute (a space, the name, and the escaped value in single quotes) to
+     * @c target. Like Tag::addAttribute(), nothing is appended if the value is empty or
+     * contains characters not allowed in XML.
+     * @param target The string to append to.
+     * @param name The attribute's name.
+     * @param value The attribute's value.
+     * @since 1.0
+     */
+    GLOOX_API void appendAttribute( std::string& target, const char* name,
+                                    const std::string& value );
 
     /**
      * Checks whether the given input is valid UTF-8.
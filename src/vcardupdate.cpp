@@ -13,6 +13,7 @@
 
 #include "vcardupdate.h"
 #include "tag.h"
+#include "util.h"
 
 namespace gloox
 {
@@ -76,4 +77,27 @@ namespace gloox
     return x;
   }
 
+  void VCardUpdate::appendXml( std::string& out ) const
+  {
+    if( !m_valid )
+      return;
+
+    out += "<x";
+    util::appendAttribute( out, "xmlns", XMLNS_X_VCARD_UPDATE );
+    if( m_notReady )
+    {
+      out += "/>";
+      return;
+    }
+
+    if( m_noImage || m_hash.empty() || !util::checkValidXMLChars( m_hash ) )
+      out += "><photo/></x>";
+    else
+    {
+      out += "><photo>";
+      util::appendEscaped( out, m_hash );
+      out += "</photo></x>";
+    }
+  }
+
 }
@@ -27,7 +27,7 @@ namespace gloox
     if( !xhtml->hasChild( "body", XMLNS, "http://www.w3.org/1999/xhtml" ) )
       return;
 
-    m_xhtml = xhtml->clone();
+    m_xhtml = xhtml->cloneShared();
   }
 
   XHtmlIM::~XHtmlIM()
@@ -43,13 +43,13 @@ namespace gloox
 
   Tag* XHtmlIM::tag() const
   {
-    return m_xhtml->clone();
+    return m_xhtml->share();
   }
 
   StanzaExtension* XHtmlIM::clone() const
   {
     XHtmlIM* x = new XHtmlIM();
-    x->m_xhtml = m_xhtml ? m_xhtml->clone() : 0;
+    x->m_xhtml = m_xhtml ? m_xhtml->share() : 0;
     return 0;
   }
 